@@ -6,6 +6,18 @@
 #include "serialization.h"
 #include "vocabulary.h"
 
+template <typename T>
+static AnalogyPairs analogies(
+    const std::string& model,
+    const Vocabulary& v,
+    unsigned long size,
+    const std::string& word,
+    unsigned long num) {
+    BasicGloVe<T> glove(v.size(), size);
+    BinaryArchiver::load(model, glove);
+    return glove.most_similary(word, num, v);
+}
+
 int main(int argc, char** argv) {
     args::ArgumentParser parser(
         "GloVe: Global Vectors for Word Representation");
@@ -22,6 +34,9 @@ int main(int argc, char** argv) {
         parser, "word", "Word", {"word"}, args::Options::Required);
     args::ValueFlag<unsigned long> num(
         parser, "num", "Number of analogies", {"num"}, 10);
+    args::ValueFlag<std::string> precision(
+        parser, "precision", "Parameter precision of the model, f32 or f64",
+        {"precision"}, "f64");
 
     try {
         parser.ParseCLI(argc, argv);
@@ -37,19 +52,28 @@ int main(int argc, char** argv) {
         return 1;
     }
 
-    // Build vocabulary
-    std::cout << "Building vocabulary..." << std::endl;
+    if (args::get(precision) != "f32" && args::get(precision) != "f64") {
+        std::cerr << "--precision should be f32 or f64" << std::endl;
+        return 1;
+    }
+
+    // Map vocabulary
+    std::cout << "Loading vocabulary..." << std::endl;
     Vocabulary v = Vocabulary();
-    BinaryArchiver::load(args::get(vocab), v);
+    v.load(args::get(vocab));
     std::cout << "Vocab size: " << v.size() << std::endl;
 
-    // Load GloVe model
-    GloVe glove(v.size(), args::get(size));
-    BinaryArchiver::load(args::get(model), glove);
-
-    // Word analogies
-    AnalogyPairs words =
-        glove.most_similary(args::get(word), args::get(num), v);
+    // Load GloVe model and find word analogies
+    AnalogyPairs words;
+    if (args::get(precision) == "f32") {
+        words = analogies<float>(
+            args::get(model), v, args::get(size), args::get(word),
+            args::get(num));
+    } else {
+        words = analogies<double>(
+            args::get(model), v, args::get(size), args::get(word),
+            args::get(num));
+    }
     for (const auto& p : words) {
         std::cout << p.first << ": " << p.second << std::endl;
     }
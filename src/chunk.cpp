@@ -0,0 +1,369 @@
+#include "chunk.h"
+#include <unistd.h>
+#include <algorithm>
+#include <cstdlib>
+#include <queue>
+#include <stdexcept>
+#include "util.h"
+
+CoChunk::CoChunk(const std::string& dir, std::size_t level) : depth(level) {
+    std::string name = path::join(dir, "cooccur.XXXXXX");
+    std::vector<char> tmpl(name.begin(), name.end());
+    tmpl.push_back('\0');
+
+    int fd = mkstemp(tmpl.data());
+    if (fd == -1 || !(fp = fdopen(fd, "w+b"))) {
+        throw std::runtime_error("failed to create temporary file: " + name);
+    }
+    unlink(tmpl.data());
+
+    // Reads and writes are buffered by the caller, a stdio buffer for every
+    // chunk would only add up
+    std::setvbuf(fp, nullptr, _IONBF, 0);
+}
+
+CoChunk::CoChunk(CoChunk&& other)
+    : fp(other.fp),
+      depth(other.depth),
+      buffer(std::move(other.buffer)),
+      capacity(other.capacity),
+      pos(other.pos),
+      count(other.count) {
+    other.fp = nullptr;
+}
+
+CoChunk::~CoChunk() {
+    if (fp) {
+        std::fclose(fp);
+    }
+}
+
+void CoChunk::write(const std::vector<CoRec>& records) {
+    write(records.data(), records.size());
+}
+
+void CoChunk::write(const CoRec* records, std::size_t n) {
+    if (std::fwrite(records, sizeof(CoRec), n, fp) != n) {
+        throw std::runtime_error("failed to write temporary chunk");
+    }
+    count += n;
+}
+
+void CoChunk::rewind(std::size_t buffer) {
+    std::fflush(fp);
+    std::rewind(fp);
+    std::vector<CoRec>().swap(this->buffer);
+    capacity = std::max(buffer, std::size_t(1));
+    pos = 0;
+}
+
+bool CoChunk::next(CoRec& record) {
+    if (pos == buffer.size()) {
+        buffer.resize(capacity);
+        buffer.resize(std::fread(buffer.data(), sizeof(CoRec), capacity, fp));
+        pos = 0;
+        if (buffer.empty()) {
+            return false;
+        }
+    }
+    record = buffer[pos++];
+    return true;
+}
+
+std::size_t CoChunk::size() const {
+    return count;
+}
+
+std::size_t CoChunk::level() const {
+    return depth;
+}
+
+CoHash::CoHash(std::size_t capacity) {
+    // Round down to a power of two
+    std::size_t size = 16;
+    for (shift = 60; size * 2 <= capacity && shift > 1; --shift) {
+        size *= 2;
+    }
+    slots.assign(size, CoRec(0, 0, 0));
+    mask = size - 1;
+}
+
+void CoHash::add(std::uint32_t i, std::uint32_t j, float weight) {
+    std::uint64_t key = (std::uint64_t(i) << 32) | j;
+    std::size_t h = (key * 0x9E3779B97F4A7C15ull) >> shift;
+    for (;; h = (h + 1) & mask) {
+        CoRec& slot = slots[h];
+        if (slot.weight == 0) {
+            slot = CoRec(i, j, weight);
+            ++count;
+            return;
+        }
+        if (slot.i == i && slot.j == j) {
+            slot.weight += weight;
+            return;
+        }
+    }
+}
+
+bool CoHash::full() const {
+    return count >= slots.size() / 4 * 3;
+}
+
+bool CoHash::empty() const {
+    return !count;
+}
+
+std::size_t CoHash::compact() {
+    auto last = std::remove_if(slots.begin(), slots.end(), [](const CoRec& r) {
+        return r.weight == 0;
+    });
+    std::sort(slots.begin(), last);
+    return last - slots.begin();
+}
+
+const CoRec* CoHash::data() const {
+    return slots.data();
+}
+
+void CoHash::clear() {
+    std::fill(slots.begin(), slots.end(), CoRec(0, 0, 0));
+    count = 0;
+}
+
+void CoHash::release() {
+    std::vector<CoRec>().swap(slots);
+    mask = count = 0;
+}
+
+void aggregate(std::vector<CoRec>& records) {
+    if (records.empty()) {
+        return;
+    }
+
+    std::sort(records.begin(), records.end());
+    auto last = records.begin();
+    for (auto iter = std::next(last); iter != records.end(); ++iter) {
+        if (*iter == *last) {
+            *last += *iter;
+        } else {
+            *(++last) = *iter;
+        }
+    }
+    records.erase(std::next(last), records.end());
+}
+
+void merge(std::vector<CoSource>& sources, const CoSink& sink) {
+    using Head = std::pair<CoRec, std::size_t>;
+    auto greater = [](const Head& x, const Head& y) {
+        return y.first < x.first;
+    };
+    std::priority_queue<Head, std::vector<Head>, decltype(greater)> heap(
+        greater);
+
+    CoRec record;
+    for (std::size_t k = 0; k != sources.size(); ++k) {
+        if (sources[k](record)) {
+            heap.emplace(record, k);
+        }
+    }
+
+    if (heap.empty()) {
+        return;
+    }
+
+    // Sum in double precision to avoid accumulating rounding errors
+    CoRec current = heap.top().first;
+    double weight = 0;
+    while (!heap.empty()) {
+        Head head = heap.top();
+        heap.pop();
+        if (sources[head.second](record)) {
+            heap.emplace(record, head.second);
+        }
+
+        if (head.first == current) {
+            weight += head.first.weight;
+        } else {
+            current.weight = weight;
+            sink(current);
+            current = head.first;
+            weight = current.weight;
+        }
+    }
+    current.weight = weight;
+    sink(current);
+}
+
+// Smallest read buffer worth merging through and the most chunks merged at
+// once
+static const std::size_t min_buffer = 1 << 10;
+static const std::size_t max_fanin = 1 << 6;
+
+static std::size_t fanin(std::size_t length) {
+    return std::min(std::max(length / min_buffer, std::size_t(2)), max_fanin);
+}
+
+// Merge chunks [first, last) into a single one, the output is buffered like
+// one more input
+static CoChunk merge(
+    std::vector<CoChunk>::iterator first,
+    std::vector<CoChunk>::iterator last,
+    std::size_t length,
+    const std::string& dir) {
+    std::size_t share = std::max(length / (last - first + 1), std::size_t(1));
+    std::size_t level = 0;
+    std::vector<CoSource> sources;
+    for (auto iter = first; iter != last; ++iter) {
+        CoChunk& chunk = *iter;
+        chunk.rewind(share);
+        sources.emplace_back(
+            [&chunk](CoRec& record) { return chunk.next(record); });
+        level = std::max(level, chunk.level() + 1);
+    }
+
+    CoChunk out(dir, level);
+    std::vector<CoRec> buffer;
+    buffer.reserve(share);
+    merge(sources, [&](const CoRec& record) {
+        buffer.push_back(record);
+        if (buffer.size() == share) {
+            out.write(buffer);
+            buffer.clear();
+        }
+    });
+    out.write(buffer);
+    return out;
+}
+
+bool collapsible(const std::vector<CoChunk>& chunks, std::size_t length) {
+    std::size_t n = fanin(length);
+    return chunks.size() >= n &&
+           chunks[chunks.size() - n].level() == chunks.back().level();
+}
+
+void collapse(
+    std::vector<CoChunk>& chunks, std::size_t length, const std::string& dir) {
+    // Levels never increase towards the top of the stack, so the trailing
+    // chunks all share a level once the first and the last of them do
+    while (collapsible(chunks, length)) {
+        auto first = chunks.end() - fanin(length);
+        CoChunk merged = merge(first, chunks.end(), length, dir);
+        while (chunks.end() != first) {
+            chunks.pop_back();
+        }
+        chunks.push_back(std::move(merged));
+    }
+}
+
+std::vector<CoSource> read_chunks(
+    std::vector<CoChunk>& chunks, std::size_t length, const std::string& dir) {
+    std::size_t n = fanin(length);
+    while (chunks.size() > n) {
+        std::vector<CoChunk> merged;
+        for (std::size_t k = 0; k < chunks.size(); k += n) {
+            auto first = chunks.begin() + k;
+            auto last = chunks.begin() + std::min(k + n, chunks.size());
+            if (last - first == 1) {
+                merged.push_back(std::move(*first));
+            } else {
+                merged.push_back(merge(first, last, length, dir));
+            }
+            // Close the merged chunks right away
+            std::for_each(first, last, [](CoChunk& chunk) {
+                CoChunk closed(std::move(chunk));
+            });
+        }
+        chunks = std::move(merged);
+    }
+
+    std::vector<CoSource> sources;
+    for (auto& chunk : chunks) {
+        chunk.rewind(length / chunks.size());
+        sources.emplace_back(
+            [&chunk](CoRec& record) { return chunk.next(record); });
+    }
+    return sources;
+}
+
+void external_sort(
+    const CoRecs& records,
+    const CoSink& sink,
+    std::size_t length,
+    const std::string& dir) {
+    std::size_t block = length ? length : records.size();
+    std::vector<CoRec> buffer;
+    std::vector<CoChunk> chunks;
+    for (std::size_t k = 0; k < records.size(); k += block) {
+        buffer.assign(
+            records.begin() + k,
+            records.begin() + std::min(k + block, records.size()));
+        aggregate(buffer);
+
+        // Everything fits in memory
+        if (chunks.empty() && k + block >= records.size()) {
+            std::for_each(buffer.begin(), buffer.end(), sink);
+            return;
+        }
+        chunks.emplace_back(dir);
+        chunks.back().write(buffer);
+    }
+    std::vector<CoRec>().swap(buffer);
+
+    std::vector<CoSource> sources = read_chunks(chunks, block, dir);
+    merge(sources, sink);
+}
+
+CoShuffler::CoShuffler(
+    const std::string& dir, std::size_t length, unsigned long seed)
+    : dir(dir), length(length), rng(seed ? seed : std::random_device()()) {
+    buffer.reserve(length);
+}
+
+void CoShuffler::add(const CoRec& record) {
+    buffer.push_back(record);
+    if (length && buffer.size() >= length) {
+        spill();
+    }
+}
+
+void CoShuffler::spill() {
+    std::shuffle(buffer.begin(), buffer.end(), rng);
+    chunks.emplace_back(dir);
+    chunks.back().write(buffer);
+    buffer.clear();
+}
+
+void CoShuffler::flush(const CoSink& sink) {
+    if (!chunks.empty() && !buffer.empty()) {
+        spill();
+    }
+
+    // Everything fits in memory
+    if (chunks.empty()) {
+        std::shuffle(buffer.begin(), buffer.end(), rng);
+        std::for_each(buffer.begin(), buffer.end(), sink);
+        buffer.clear();
+        return;
+    }
+
+    // Take an equal share from every chunk, shuffle and write them out
+    std::size_t share = std::max(length / chunks.size(), std::size_t(1));
+    for (auto& chunk : chunks) {
+        chunk.rewind(share);
+    }
+    bool exhausted = false;
+    while (!exhausted) {
+        exhausted = true;
+        CoRec record;
+        for (auto& chunk : chunks) {
+            for (std::size_t k = 0; k != share && chunk.next(record); ++k) {
+                buffer.push_back(record);
+                exhausted = false;
+            }
+        }
+        std::shuffle(buffer.begin(), buffer.end(), rng);
+        std::for_each(buffer.begin(), buffer.end(), sink);
+        buffer.clear();
+    }
+    chunks.clear();
+}
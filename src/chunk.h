@@ -0,0 +1,114 @@
+#ifndef _SRC_CHUNK_H_
+#define _SRC_CHUNK_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+#include "cooccur.h"
+
+using CoSource = std::function<bool(CoRec&)>;
+
+// A run of co-occurrence records spilled to a temporary file. The file is
+// unlinked right after creation so it never outlives the process. The level
+// counts how many merges the run went through.
+class CoChunk {
+public:
+    explicit CoChunk(const std::string& dir, std::size_t level = 0);
+    CoChunk(const CoChunk& other) = delete;
+    CoChunk(CoChunk&& other);
+    ~CoChunk();
+
+    void write(const std::vector<CoRec>& records);
+    void write(const CoRec* records, std::size_t n);
+
+    // Read from the start again, `buffer` records at a time
+    void rewind(std::size_t buffer = 1 << 14);
+    bool next(CoRec& record);
+    std::size_t size() const;
+    std::size_t level() const;
+
+private:
+    std::FILE* fp = nullptr;
+    std::size_t depth = 0;
+    std::vector<CoRec> buffer;
+    std::size_t capacity = 0;
+    std::size_t pos = 0;
+    std::size_t count = 0;
+};
+
+// Bounded open addressing table which sums up repeated (i, j) pairs as they
+// are counted. Slots with a zero weight are empty.
+class CoHash {
+public:
+    explicit CoHash(std::size_t capacity);
+
+    void add(std::uint32_t i, std::uint32_t j, float weight);
+    bool full() const;
+    bool empty() const;
+
+    // Move the records to the front in sorted order and return their number,
+    // the table has to be cleared before adding again
+    std::size_t compact();
+    const CoRec* data() const;
+    void clear();
+    void release();
+
+private:
+    std::vector<CoRec> slots;
+    std::size_t mask = 0;
+    std::size_t count = 0;
+    int shift = 64;
+};
+
+// Sort records by (i, j) and sum up duplicates in place
+void aggregate(std::vector<CoRec>& records);
+
+// K-way merge sorted sources, duplicates are summed before reaching the sink
+void merge(std::vector<CoSource>& sources, const CoSink& sink);
+
+// Merge the trailing chunks of a stack of sorted chunks into one as long as
+// the last fan-in of them share a level, which keeps the stack logarithmic in
+// the number of runs spilled onto it. Merges read and write through buffers
+// of `length` records in total, `collapsible` tells whether one is due.
+bool collapsible(const std::vector<CoChunk>& chunks, std::size_t length);
+void collapse(
+    std::vector<CoChunk>& chunks, std::size_t length, const std::string& dir);
+
+// Sorted sources of `chunks` whose read buffers hold `length` records in
+// total. Chunks beyond the fan-in this allows are merged in several passes
+// first, which keeps both the memory and the open files bounded.
+std::vector<CoSource> read_chunks(
+    std::vector<CoChunk>& chunks, std::size_t length, const std::string& dir);
+
+// Sort records in blocks of `length` (all at once if zero) which are spilled
+// into chunks and merged into the sink
+void external_sort(
+    const CoRecs& records,
+    const CoSink& sink,
+    std::size_t length,
+    const std::string& dir);
+
+// Shuffle a stream of records in bounded memory like the reference `shuffle`
+// tool: blocks of `length` records are shuffled and spilled into chunks,
+// which are then interleaved randomly. A zero `length` shuffles in memory.
+class CoShuffler {
+public:
+    CoShuffler(const std::string& dir, std::size_t length, unsigned long seed);
+
+    void add(const CoRec& record);
+    void flush(const CoSink& sink);
+
+private:
+    void spill();
+
+    const std::string& dir;
+    std::size_t length;
+    std::mt19937 rng;
+    std::vector<CoRec> buffer;
+    std::vector<CoChunk> chunks;
+};
+
+#endif /* _SRC_CHUNK_H_ */
@@ -1,63 +1,311 @@
 #include "cooccur.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
 #include <deque>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include "chunk.h"
+#include "encoder.h"
+#include "gzip.h"
+#include "tokenizer.h"
 #include "util.h"
 
-CoRecs CoMatrixBuilder::build(
-    const std::string& file,
-    const Vocabulary& vocab,
-    unsigned long window,
-    bool symmetric,
-    unsigned long threshold,
-    bool shuffle) {
-    // Check whether a word is OOV
-    auto lookup = [&](const std::string& key, unsigned long& id) {
-        try {
-            id = vocab[key];
-        } catch (const std::out_of_range& e) {
-            return 0;
+// CoRecs
+CoRecs::CoRecs(CoRecs&& other)
+    : records(std::move(other.records)),
+      mapping(other.mapping),
+      length(other.length),
+      mapped(other.mapped),
+      count(other.count) {
+    other.mapping = nullptr;
+    other.mapped = nullptr;
+    other.length = other.count = 0;
+}
+
+CoRecs::~CoRecs() {
+    clear();
+}
+
+CoRecs& CoRecs::operator=(CoRecs&& other) {
+    if (this != &other) {
+        clear();
+        records = std::move(other.records);
+        std::swap(mapping, other.mapping);
+        std::swap(length, other.length);
+        std::swap(mapped, other.mapped);
+        std::swap(count, other.count);
+    }
+    return *this;
+}
+
+CoRecs CoRecs::map(
+    const std::string& file, std::size_t offset, std::size_t count) {
+    CoRecs recs;
+    int fd = open(file.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd == -1 || fstat(fd, &st) == -1) {
+        if (fd != -1) {
+            close(fd);
         }
-        return 1;
-    };
+        throw std::runtime_error("failed to open file: " + file);
+    }
+    if (std::size_t(st.st_size) < offset + count * sizeof(CoRec)) {
+        close(fd);
+        throw std::runtime_error("truncated co-occurrence file: " + file);
+    }
 
-    // Build an auxiliary lookup table
-    std::size_t vsize = vocab.size();
-    std::vector<unsigned long> index(vsize + 1, 0);
-    index[0] = 0;
+    recs.length = st.st_size;
+    if (recs.length) {
+        recs.mapping = mmap(
+            nullptr, recs.length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (recs.mapping == MAP_FAILED) {
+        recs.mapping = nullptr;
+        throw std::runtime_error("failed to map file: " + file);
+    }
+    if (recs.mapping) {
+        recs.mapped = reinterpret_cast<CoRec*>(
+            static_cast<char*>(recs.mapping) + offset);
+        recs.count = count;
+    }
+    return recs;
+}
+
+void CoRecs::push_back(const CoRec& record) {
+    if (mapped) {
+        throw std::logic_error("cannot append to mapped co-occurrence records");
+    }
+    records.push_back(record);
+}
+
+void CoRecs::reserve(std::size_t n) {
+    if (!mapped) {
+        records.reserve(n);
+    }
+}
+
+void CoRecs::clear() {
+    if (mapping) {
+        munmap(mapping, length);
+    }
+    mapping = nullptr;
+    mapped = nullptr;
+    length = count = 0;
+    records.clear();
+}
+
+std::size_t CoRecs::size() const {
+    return mapped ? count : records.size();
+}
+
+bool CoRecs::empty() const {
+    return !size();
+}
+
+CoRec* CoRecs::data() {
+    return mapped ? mapped : records.data();
+}
+
+const CoRec* CoRecs::data() const {
+    return mapped ? mapped : records.data();
+}
+
+CoRecs::iterator CoRecs::begin() {
+    return data();
+}
+
+CoRecs::iterator CoRecs::end() {
+    return data() + size();
+}
+
+CoRecs::const_iterator CoRecs::begin() const {
+    return data();
+}
+
+CoRecs::const_iterator CoRecs::end() const {
+    return data() + size();
+}
+
+CoRec& CoRecs::operator[](std::size_t k) {
+    return data()[k];
+}
+
+const CoRec& CoRecs::operator[](std::size_t k) const {
+    return data()[k];
+}
+
+// Number of cells of the dense bigram table for a given threshold
+static std::size_t table_size(unsigned long threshold, std::size_t vsize) {
+    std::size_t cells = 0;
     for (std::size_t i = 1; i != vsize + 1; ++i) {
-        index[i] = index[i - 1] + std::min(threshold / i, vsize);
+        cells += std::min(threshold / i, vsize);
     }
-    std::vector<double> bigram_table(index[vsize], 0);
+    return cells;
+}
 
-    // Open corpus file and ready to read
-    std::ifstream is;
-    file::open(is, file);
-    std::string word, center, context;
+// Id range of an encoded corpus, aligned to line starts
+struct IdShard {
+    const std::uint32_t* begin;
+    const std::uint32_t* end;
+};
 
-    // Context and its availability
-    std::deque<unsigned long> ids;
-    std::deque<bool> flags;
+// Ids of a mapped encoded corpus
+struct IdFile {
+    MappedFile mapping;
+    const std::uint32_t* begin;
+    const std::uint32_t* end;
+};
 
-    // Center and its availability
-    unsigned long id;
-    bool exists;
-
-    // Put the first word of the first line into context
-    is >> context;
-    exists = lookup(context, id);
-    ids.push_back(exists ? id : 0);
-    flags.push_back(exists);
-
-    std::list<CoRec> low_cooccur;  // TODO: split into chunks
-    while (!is.eof()) {
-        is >> center;
-        // If this line has only 1 word, skip
-        if (center.empty()) {
-            continue;
+// Per thread co-occurrence accumulator: a dense table for frequent pairs and
+// a hash table summing up the others, which is flushed into sorted runs once
+// it fills up. Runs are spilled into chunks under a memory budget.
+class CoCounter {
+public:
+    CoCounter(
+        const std::vector<unsigned long>& index,
+        unsigned long threshold,
+        std::size_t overflow_length,
+        std::size_t hash_length,
+        const std::string& tmpdir)
+        : index(index),
+          threshold(threshold),
+          overflow_length(overflow_length),
+          tmpdir(tmpdir),
+          bigram_table(index.back(), 0),
+          low_cooccur(overflow_length ? overflow_length : hash_length) {}
+
+    void add(std::uint32_t i, std::uint32_t j, double weight) {
+        if (threshold / (i + 1) >= (j + 1)) {
+            bigram_table[index[i] + j] += weight;
+            return;
+        }
+
+        low_cooccur.add(i, j, weight);
+        if (low_cooccur.full()) {
+            flush();
+        }
+    }
+
+    // Sorted sources of the dense table and the runs, the chunks are handed
+    // over to `spilled` to be merged along with those of the other threads
+    void sources(std::vector<CoSource>& srcs, std::vector<CoChunk>& spilled) {
+        row = col = 0;
+        srcs.emplace_back([this](CoRec& record) {
+            for (; row + 1 != index.size(); ++row, col = 0) {
+                for (; col != index[row + 1] - index[row]; ++col) {
+                    double weight = bigram_table[index[row] + col];
+                    if (weight > 0) {
+                        record = CoRec(row, col++, weight);
+                        return true;
+                    }
+                }
+            }
+            return false;
+        });
+
+        // The hash table is not needed anymore, under a memory budget its
+        // memory is handed over to the shuffle
+        if (!low_cooccur.empty()) {
+            flush();
         }
+        low_cooccur.release();
 
-        exists = lookup(center, id);
+        for (const auto& run : runs) {
+            std::size_t pos = 0;
+            srcs.emplace_back([&run, pos](CoRec& record) mutable {
+                if (pos == run.size()) {
+                    return false;
+                }
+                record = run[pos++];
+                return true;
+            });
+        }
+
+        for (auto& chunk : chunks) {
+            spilled.push_back(std::move(chunk));
+        }
+        chunks.clear();
+    }
+
+private:
+    void flush() {
+        std::size_t n = low_cooccur.compact();
+        if (overflow_length) {
+            chunks.emplace_back(tmpdir);
+            chunks.back().write(low_cooccur.data(), n);
+
+            // Keep the open chunks bounded, merging them takes over the
+            // memory of the hash table
+            if (collapsible(chunks, overflow_length)) {
+                low_cooccur.release();
+                collapse(chunks, overflow_length, tmpdir);
+                low_cooccur = CoHash(overflow_length);
+                return;
+            }
+        } else {
+            runs.emplace_back(low_cooccur.data(), low_cooccur.data() + n);
+        }
+        low_cooccur.clear();
+    }
+
+    const std::vector<unsigned long>& index;
+    unsigned long threshold;
+    std::size_t overflow_length;
+    const std::string& tmpdir;
+    std::vector<double> bigram_table;
+    CoHash low_cooccur;
+    std::vector<std::vector<CoRec>> runs;
+    std::vector<CoChunk> chunks;
+    std::size_t row = 0;
+    std::size_t col = 0;
+};
+
+// Split encoded corpora into about `num` id ranges each
+static std::vector<IdShard> shards(
+    const std::vector<IdFile>& corpora, unsigned long num) {
+    std::vector<IdShard> result;
+    for (const auto& corpus : corpora) {
+        std::size_t step = (corpus.end - corpus.begin) / num + 1;
+        const std::uint32_t* begin = corpus.begin;
+        while (begin != corpus.end) {
+            const std::uint32_t* end =
+                begin + std::min(step, std::size_t(corpus.end - begin));
+            end = std::find(end, corpus.end, IdCorpus::newline);
+            end += end != corpus.end;
+            result.push_back({begin, end});
+            begin = end;
+        }
+    }
+    return result;
+}
+
+// Sliding window over the preceding words of the current line. It spans the
+// largest window, every pair is counted for all the windows it falls into.
+class Context {
+public:
+    Context(
+        const std::vector<unsigned long>& windows,
+        bool symmetric,
+        const std::vector<CoCounter*>& counters)
+        : windows(windows),
+          window(windows.back()),
+          symmetric(symmetric),
+          counters(counters) {}
+
+    // Separate context between paragraphs
+    void reset() {
+        ids.clear();
+        flags.clear();
+    }
+
+    void add(unsigned long id, bool exists) {
         if (exists) {
             for (std::size_t i = 0; i != ids.size(); ++i) {
                 // If context word is OOV, skip
@@ -65,102 +313,464 @@ CoRecs CoMatrixBuilder::build(
                     continue;
                 }
 
-                double weight = 1.0 / (ids.size() - i);
-                bool flag = (threshold / (id + 1) >= (ids[i] + 1));
-                if (flag) {
-                    bigram_table[index[id] + ids[i]] += weight;
-                } else {
-                    low_cooccur.emplace_back(id, ids[i], weight);
-                }
-
-                if (symmetric) {
-                    if (flag) {
-                        bigram_table[index[ids[i]] + id + 1] += weight;
-                    } else {
-                        low_cooccur.emplace_back(ids[i], id, weight);
+                // Windows are sorted, count into those covering the distance
+                std::size_t distance = ids.size() - i;
+                double weight = 1.0 / distance;
+                for (std::size_t k = windows.size();
+                     k-- && windows[k] >= distance;) {
+                    counters[k]->add(id, ids[i], weight);
+                    if (symmetric) {
+                        counters[k]->add(ids[i], id, weight);
                     }
                 }
             }
         }
 
-        // If line breaks, separate context between paragraphs
-        if (is.peek() == '\n') {
-            ids.clear();
-            flags.clear();
-            is >> context;
-            exists = lookup(context, id);
-            ids.push_back(exists ? id : 0);
-            flags.push_back(exists);
-            center = "";
+        // Remove the oldest history
+        if (ids.size() >= window) {
+            ids.pop_front();
+            flags.pop_front();
+        }
+        // Current center word becomes history
+        ids.push_back(id);
+        flags.push_back(exists);
+    }
+
+private:
+    const std::vector<unsigned long>& windows;
+    unsigned long window;
+    bool symmetric;
+    const std::vector<CoCounter*>& counters;
+    std::deque<unsigned long> ids;
+    std::deque<bool> flags;
+};
+
+// Count the lines of a shard
+static void count(
+    const Shard& shard, const Vocabulary& vocab, Context& context) {
+    Tokenizer tokenizer(shard.begin, shard.end);
+    Token token;
+    Tokenizer::Event event;
+    context.reset();
+    while ((event = tokenizer.next(token)) != Tokenizer::END) {
+        if (event == Tokenizer::NEWLINE) {
+            context.reset();
+            continue;
+        }
+
+        // Check whether a word is OOV
+        std::size_t id = 0;
+        bool exists = vocab.find(token.data, token.size, id);
+        context.add(id, exists);
+    }
+}
+
+// Count the lines of an encoded shard, no strings are involved
+static void count(const IdShard& shard, Context& context) {
+    context.reset();
+    for (const std::uint32_t* p = shard.begin; p != shard.end; ++p) {
+        if (*p == IdCorpus::newline) {
+            context.reset();
         } else {
-            // Remove the oldest history
-            if (ids.size() >= window) {
-                ids.pop_front();
-                flags.pop_front();
-            }
-            // Current center word becomes history
-            ids.push_back(id);
-            flags.push_back(exists);
+            context.add(*p == IdCorpus::oov ? 0 : *p, *p != IdCorpus::oov);
         }
     }
-    is.close();
+}
 
-    // Turn the bigram records into `CoRec` records
-    std::list<CoRec> high_cooccur;
-    for (std::size_t i = 0; i != vsize; ++i) {
-        for (std::size_t j = 0; j != index[i + 1] - index[i]; ++j) {
-            double weight = bigram_table[index[i] + j];
-            if (weight > 0) {
-                high_cooccur.emplace_back(i, j, weight);
-            }
+CoRecs CoMatrixBuilder::build(
+    const std::string& file,
+    const Vocabulary& vocab,
+    unsigned long window,
+    bool symmetric,
+    unsigned long threshold,
+    bool shuffle,
+    double memory,
+    const std::string& tmpdir,
+    unsigned long threads,
+    unsigned long seed) {
+    return build(
+        std::vector<std::string>{file}, vocab, window, symmetric, threshold,
+        shuffle, memory, tmpdir, threads, seed);
+}
+
+CoRecs CoMatrixBuilder::build(
+    const std::vector<std::string>& files,
+    const Vocabulary& vocab,
+    unsigned long window,
+    bool symmetric,
+    unsigned long threshold,
+    bool shuffle,
+    double memory,
+    const std::string& tmpdir,
+    unsigned long threads,
+    unsigned long seed) {
+    CoRecs cooccur;
+    build(
+        [&cooccur](const CoRec& record) { cooccur.push_back(record); }, files,
+        vocab, window, symmetric, threshold, shuffle, memory, tmpdir, threads,
+        seed);
+    return cooccur;
+}
+
+void CoMatrixBuilder::build(
+    const CoSink& sink,
+    const std::vector<std::string>& files,
+    const Vocabulary& vocab,
+    unsigned long window,
+    bool symmetric,
+    unsigned long threshold,
+    bool shuffle,
+    double memory,
+    const std::string& tmpdir,
+    unsigned long threads,
+    unsigned long seed) {
+    update(
+        sink, CoSink(), CoRecs(), files, vocab, window, symmetric, threshold,
+        shuffle, memory, tmpdir, threads, seed);
+}
+
+// Count `files` once for all the `windows` and stream the matrix of each
+// window, merged with its base matrix, into its sinks
+static void process(
+    const std::vector<CoSink>& sinks,
+    const std::vector<CoSink>& sorted,
+    const std::vector<const CoRecs*>& bases,
+    const std::vector<std::string>& files,
+    const Vocabulary& vocab,
+    const std::vector<unsigned long>& windows,
+    bool symmetric,
+    unsigned long threshold,
+    bool shuffle,
+    double memory,
+    const std::string& tmpdir,
+    unsigned long threads,
+    unsigned long seed) {
+    threads = std::max(threads, 1ul);
+
+    // Windows in ascending order, `order` maps them back to their sinks
+    std::size_t num = windows.size();
+    std::vector<std::size_t> order(num);
+    for (std::size_t k = 0; k != num; ++k) {
+        order[k] = k;
+    }
+    std::stable_sort(
+        order.begin(), order.end(),
+        [&](std::size_t x, std::size_t y) { return windows[x] < windows[y]; });
+    std::vector<unsigned long> ascending;
+    for (auto k : order) {
+        ascending.push_back(windows[k]);
+    }
+
+    // Each thread and window gets an equal share of the memory budget, at
+    // most half of which goes to its bigram table, the rest is used to
+    // buffer low frequency records before spilling them to disk
+    std::size_t vsize = vocab.size();
+    std::size_t budget = memory * 1024 * 1024 / threads / num;
+    std::size_t overflow_length = 0;
+    std::size_t hash_length = 1 << 21;
+    if (budget) {
+        while (threshold > 1 &&
+               table_size(threshold, vsize) * sizeof(double) > budget / 2) {
+            threshold /= 2;
+        }
+        overflow_length = std::max(
+            (budget - table_size(threshold, vsize) * sizeof(double)) /
+                sizeof(CoRec),
+            std::size_t(1));
+    } else {
+        // Without a budget the bigram and hash tables of all threads and
+        // windows together stay within the ones a single count would use
+        hash_length =
+            std::max(hash_length / threads / num, std::size_t(1) << 16);
+        std::size_t cells = table_size(threshold, vsize);
+        while (threshold > 1 &&
+               table_size(threshold, vsize) * threads * num > cells) {
+            threshold /= 2;
         }
     }
 
-    // Merge sorted high and low `CoRec`s
-    // TODO: Merge and aggregate at the same time
-    low_cooccur.sort();
-    high_cooccur.merge(low_cooccur);
+    // Build an auxiliary lookup table
+    std::vector<unsigned long> index(vsize + 1, 0);
+    index[0] = 0;
+    for (std::size_t i = 1; i != vsize + 1; ++i) {
+        index[i] = index[i - 1] + std::min(threshold / i, vsize);
+    }
 
-    // Aggregate duplicate records
-    std::list<CoRec> cooccur;
-    cooccur.push_back(std::move(high_cooccur.front()));
-    high_cooccur.pop_front();
-    while (!high_cooccur.empty()) {
-        CoRec current = std::move(high_cooccur.front());
-        high_cooccur.pop_front();
-        if (current == cooccur.back()) {
-            cooccur.back() += current;
+    // Encoded corpora have to match the ids of the vocabulary, compressed
+    // ones are decompressed in the background while the others are counted
+    std::vector<MappedFile> corpora;
+    std::vector<IdFile> encoded;
+    std::vector<std::unique_ptr<GzipReader>> readers;
+    for (const auto& file : files) {
+        if (IdCorpus::detect(file)) {
+            IdCorpusHeader header = IdCorpus::header(file);
+            if (header.vocab != IdCorpus::signature(vocab)) {
+                throw std::runtime_error(
+                    "vocabulary mismatch of encoded corpus: " + file);
+            }
+            MappedFile mapping(file);
+            if (mapping.size() <
+                sizeof(header) + header.count * sizeof(std::uint32_t)) {
+                throw std::runtime_error("truncated encoded corpus: " + file);
+            }
+            const std::uint32_t* begin = reinterpret_cast<const std::uint32_t*>(
+                mapping.begin() + sizeof(header));
+            encoded.push_back(
+                {std::move(mapping), begin, begin + header.count});
+        } else if (GzipReader::detect(file)) {
+            readers.emplace_back(new GzipReader(file));
         } else {
-            cooccur.push_back(current);
+            corpora.emplace_back(file);
         }
     }
+    std::vector<Shard> jobs = shards(corpora, threads);
+    std::vector<IdShard> id_jobs = shards(encoded, threads);
 
-#ifndef NDEBUG
-    // To check whether all the co-occurrence records are sorted by id
-    for (auto iter = cooccur.begin(); std::next(iter) != cooccur.end();
-         ++iter) {
-        auto next = std::next(iter);
-        if ((*next) <= (*iter)) {
-            std::cerr << "found unmerged or unsorted co-occurence record: ("
-                      << iter->i << ", " << iter->j << ", " << iter->weight
-                      << ") <->"
-                      << "(" << next->i << ", " << next->j << ", "
-                      << next->weight << ")" << std::endl;
+    // Count shards in parallel, each thread into its own counters
+    std::vector<std::unique_ptr<CoCounter>> counters;
+    std::vector<std::vector<CoCounter*>> contexts(threads);
+    for (std::size_t i = 0; i != threads; ++i) {
+        for (std::size_t k = 0; k != num; ++k) {
+            counters.emplace_back(new CoCounter(
+                index, threshold, overflow_length, hash_length, tmpdir));
+            contexts[i].push_back(counters.back().get());
         }
     }
+
+    std::atomic<std::size_t> cursor(0);
+    std::atomic<std::size_t> id_cursor(0);
+    parallel(threads, [&](std::size_t i) {
+        Context context(ascending, symmetric, contexts[i]);
+        for (std::size_t k = id_cursor++; k < id_jobs.size();
+             k = id_cursor++) {
+            count(id_jobs[k], context);
+        }
+        for (std::size_t k = cursor++; k < jobs.size(); k = cursor++) {
+            count(jobs[k], vocab, context);
+        }
+        std::vector<char> block;
+        for (auto& reader : readers) {
+            while (reader->next(block)) {
+                Shard shard{block.data(), block.data() + block.size()};
+                count(shard, vocab, context);
+            }
+        }
+    });
+
+    // Collect the sorted sources of every window first, which releases all
+    // the overflow buffers
+    std::vector<std::vector<CoSource>> sources(num);
+    std::vector<std::vector<CoChunk>> spilled(num);
+    for (std::size_t i = 0; i != threads; ++i) {
+        for (std::size_t k = 0; k != num; ++k) {
+            contexts[i][k]->sources(sources[k], spilled[k]);
+        }
+    }
+
+    // Half of the budget given to the overflow buffers, which are empty by
+    // now, buffers the reads of the spilled chunks, the other half the shuffle
+    std::size_t spare = budget * threads * num / 2 / sizeof(CoRec);
+
+    for (std::size_t k = 0; k != num; ++k) {
+        const CoSink& sink = sinks[order[k]];
+        const CoSink& tee = sorted[order[k]];
+        const CoRecs* base = bases[order[k]];
+
+        // Merge the partial results of all threads into the base matrix,
+        // aggregating duplicate records on the fly
+        const CoRec* iter = base ? base->begin() : nullptr;
+        const CoRec* last = base ? base->end() : nullptr;
+        sources[k].emplace_back([&](CoRec& record) {
+            if (iter == last) {
+                return false;
+            }
+            record = *iter++;
+            return true;
+        });
+
+        std::vector<CoSource> chunk_sources =
+            read_chunks(spilled[k], spare / 2, tmpdir);
+        sources[k].insert(
+            sources[k].end(), chunk_sources.begin(), chunk_sources.end());
+
+        CoShuffler shuffler(tmpdir, spare / 2 + (budget ? 1 : 0), seed);
+
+#ifndef NDEBUG
+        // To check whether all the co-occurrence records are sorted by id
+        bool first = true;
+        CoRec prev;
 #endif
+        merge(sources[k], [&](const CoRec& record) {
+#ifndef NDEBUG
+            if (!first && record <= prev) {
+                std::cerr << "found unmerged or unsorted co-occurence record: ("
+                          << prev.i << ", " << prev.j << ", " << prev.weight
+                          << ") <->"
+                          << "(" << record.i << ", " << record.j << ", "
+                          << record.weight << ")" << std::endl;
+            }
+            first = false;
+            prev = record;
+#endif
+            if (tee) {
+                tee(record);
+            }
+            if (shuffle) {
+                shuffler.add(record);
+            } else {
+                sink(record);
+            }
+        });
+        shuffler.flush(sink);
+
+        // Free the counters of this window before the next one is merged
+        sources[k].clear();
+        spilled[k].clear();
+        for (std::size_t i = 0; i != threads; ++i) {
+            counters[i * num + k].reset();
+        }
+    }
+}
 
-    if (shuffle) {
-        std::vector<CoRec> vec_records(
-            std::make_move_iterator(cooccur.begin()),
-            std::make_move_iterator(cooccur.end()));
-        std::shuffle(
-            vec_records.begin(), vec_records.end(),
-            std::mt19937(std::random_device()()));
-        std::copy(
-            std::make_move_iterator(vec_records.begin()),
-            std::make_move_iterator(vec_records.end()), cooccur.begin());
+void CoMatrixBuilder::build(
+    const std::vector<CoSink>& sinks,
+    const std::vector<std::string>& files,
+    const Vocabulary& vocab,
+    const std::vector<unsigned long>& windows,
+    bool symmetric,
+    unsigned long threshold,
+    bool shuffle,
+    double memory,
+    const std::string& tmpdir,
+    unsigned long threads,
+    unsigned long seed) {
+    if (sinks.size() != windows.size() || windows.empty()) {
+        throw std::invalid_argument("expected one sink per window");
     }
+    process(
+        sinks, std::vector<CoSink>(sinks.size()),
+        std::vector<const CoRecs*>(sinks.size(), nullptr), files, vocab,
+        windows, symmetric, threshold, shuffle, memory, tmpdir, threads, seed);
+}
 
-    return cooccur;
+void CoMatrixBuilder::update(
+    const CoSink& sink,
+    const CoSink& sorted,
+    const CoRecs& base,
+    const std::vector<std::string>& files,
+    const Vocabulary& vocab,
+    unsigned long window,
+    bool symmetric,
+    unsigned long threshold,
+    bool shuffle,
+    double memory,
+    const std::string& tmpdir,
+    unsigned long threads,
+    unsigned long seed) {
+    process(
+        {sink}, {sorted}, {&base}, files, vocab, {window}, symmetric,
+        threshold, shuffle, memory, tmpdir, threads, seed);
+}
+
+// CoMatrixFile
+static const char co_magic[8] = {'G', 'L', 'O', 'V', 'E', 'C', 'O', '\0'};
+
+static CoMatrixHeader make_header(
+    const CoMatrixKey& key,
+    std::uint64_t vocab,
+    bool sorted,
+    std::uint64_t count) {
+    CoMatrixHeader header;
+    std::copy(co_magic, co_magic + 8, header.magic);
+    header.version = CoMatrixFile::version;
+    header.record_size = sizeof(CoRec);
+    header.key = key;
+    header.vocab = vocab;
+    header.sorted = sorted;
+    header.count = count;
+    return header;
+}
+
+static bool read_header(const std::string& file, CoMatrixHeader& header) {
+    std::ifstream is(file, std::ios::binary);
+    if (!is.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        return false;
+    }
+    return std::equal(co_magic, co_magic + 8, header.magic) &&
+           header.version == CoMatrixFile::version &&
+           header.record_size == sizeof(CoRec);
+}
+
+void CoMatrixFile::save(
+    const std::string& file,
+    const CoMatrixKey& key,
+    std::uint64_t vocab,
+    const CoRecs& cooccur,
+    bool sorted) {
+    CoMatrixWriter writer(file, key, vocab, sorted);
+    for (const auto& record : cooccur) {
+        writer.write(record);
+    }
+    writer.close();
+}
+
+bool CoMatrixFile::match(
+    const std::string& file, const CoMatrixKey& key, std::uint64_t vocab) {
+    CoMatrixHeader header;
+    return read_header(file, header) && header.key == key &&
+           header.vocab == vocab;
+}
+
+CoMatrixHeader CoMatrixFile::header(const std::string& file) {
+    CoMatrixHeader header;
+    if (!read_header(file, header)) {
+        throw std::runtime_error("invalid co-occurrence file: " + file);
+    }
+    return header;
+}
+
+CoRecs CoMatrixFile::load(const std::string& file) {
+    return CoRecs::map(file, sizeof(CoMatrixHeader), header(file).count);
+}
+
+// CoMatrixWriter
+CoMatrixWriter::CoMatrixWriter(
+    const std::string& file,
+    const CoMatrixKey& key,
+    std::uint64_t vocab,
+    bool sorted)
+    : file(file), tmp(file + ".tmp"), key(key), vocab(vocab), sorted(sorted) {
+    // Write into a temporary file first so that an interrupted write never
+    // leaves a valid looking but truncated matrix behind
+    file::open(os, tmp, std::ios::binary);
+    CoMatrixHeader header = make_header(key, vocab, sorted, 0);
+    os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    buffer.reserve(1 << 16);
+}
+
+void CoMatrixWriter::write(const CoRec& record) {
+    buffer.push_back(record);
+    if (buffer.size() == buffer.capacity()) {
+        os.write(
+            reinterpret_cast<const char*>(buffer.data()),
+            sizeof(CoRec) * buffer.size());
+        count += buffer.size();
+        buffer.clear();
+    }
+}
+
+void CoMatrixWriter::close() {
+    os.write(
+        reinterpret_cast<const char*>(buffer.data()),
+        sizeof(CoRec) * buffer.size());
+    count += buffer.size();
+    buffer.clear();
+
+    CoMatrixHeader header = make_header(key, vocab, sorted, count);
+    os.seekp(0);
+    os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    os.close();
+    if (!os || std::rename(tmp.c_str(), file.c_str())) {
+        throw std::runtime_error("failed to write co-occurrence file: " + file);
+    }
 }
@@ -1,29 +1,22 @@
 #ifndef _SRC_COOCCUR_H_
 #define _SRC_COOCCUR_H_
 
-#include <list>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
 #include "vocabulary.h"
 
+// Packed co-occurrence record, 12 bytes per nonzero
 struct CoRec {
-    unsigned long i;
-    unsigned long j;
-    double weight;
+    std::uint32_t i;
+    std::uint32_t j;
+    float weight;
 
-    CoRec() = delete;
-    CoRec(unsigned long i, unsigned long j, double weight)
+    CoRec() = default;
+    CoRec(std::uint32_t i, std::uint32_t j, float weight)
         : i(i), j(j), weight(weight) {}
-    CoRec(const CoRec& o) : i(o.i), j(o.j), weight(o.weight) {}
-    CoRec(CoRec&& o) : i(o.i), j(o.j), weight(o.weight) {}
-
-    CoRec& operator=(const CoRec& x) {
-        if (this == &x) {
-            return *this;
-        }
-        i = x.i;
-        j = x.j;
-        weight = x.weight;
-        return *this;
-    }
 
     CoRec& operator+=(const CoRec& x) {
         if (i == x.i && j == x.j) {
@@ -45,7 +38,49 @@ struct CoRec {
     }
 };
 
-using CoRecs = std::list<CoRec>;
+static_assert(sizeof(CoRec) == 12, "CoRec should be packed");
+
+// Contiguous co-occurrence records, either owned or mapped from a file. A
+// mapping is private so that in place updates never reach the file.
+class CoRecs {
+public:
+    using iterator = CoRec*;
+    using const_iterator = const CoRec*;
+
+    CoRecs() = default;
+    CoRecs(const CoRecs& other) = delete;
+    CoRecs(CoRecs&& other);
+    ~CoRecs();
+
+    CoRecs& operator=(CoRecs&& other);
+
+    static CoRecs map(
+        const std::string& file, std::size_t offset, std::size_t count);
+
+    void push_back(const CoRec& record);
+    void reserve(std::size_t n);
+    void clear();
+    std::size_t size() const;
+    bool empty() const;
+
+    CoRec* data();
+    const CoRec* data() const;
+    iterator begin();
+    iterator end();
+    const_iterator begin() const;
+    const_iterator end() const;
+    CoRec& operator[](std::size_t k);
+    const CoRec& operator[](std::size_t k) const;
+
+private:
+    std::vector<CoRec> records;
+    void* mapping = nullptr;
+    std::size_t length = 0;
+    CoRec* mapped = nullptr;
+    std::size_t count = 0;
+};
+
+using CoSink = std::function<void(const CoRec&)>;
 
 class CoMatrixBuilder {
 public:
@@ -57,7 +92,146 @@ public:
         unsigned long window = 10,
         bool symmetric = true,
         unsigned long threshold = 5000 * 5000,
-        bool shuffle = true);
+        bool shuffle = true,
+        double memory = 0,
+        const std::string& tmpdir = "./",
+        unsigned long threads = 1,
+        unsigned long seed = 0);
+    static CoRecs build(
+        const std::vector<std::string>& files,
+        const Vocabulary& vocab,
+        unsigned long window = 10,
+        bool symmetric = true,
+        unsigned long threshold = 5000 * 5000,
+        bool shuffle = true,
+        double memory = 0,
+        const std::string& tmpdir = "./",
+        unsigned long threads = 1,
+        unsigned long seed = 0);
+
+    // Stream the records into `sink` instead of keeping them in memory
+    static void build(
+        const CoSink& sink,
+        const std::vector<std::string>& files,
+        const Vocabulary& vocab,
+        unsigned long window = 10,
+        bool symmetric = true,
+        unsigned long threshold = 5000 * 5000,
+        bool shuffle = true,
+        double memory = 0,
+        const std::string& tmpdir = "./",
+        unsigned long threads = 1,
+        unsigned long seed = 0);
+
+    // Count `files` once for several window sizes, the matrix of
+    // `windows[k]` is streamed into `sinks[k]`
+    static void build(
+        const std::vector<CoSink>& sinks,
+        const std::vector<std::string>& files,
+        const Vocabulary& vocab,
+        const std::vector<unsigned long>& windows,
+        bool symmetric = true,
+        unsigned long threshold = 5000 * 5000,
+        bool shuffle = true,
+        double memory = 0,
+        const std::string& tmpdir = "./",
+        unsigned long threads = 1,
+        unsigned long seed = 0);
+
+    // Count `files` against a fixed vocabulary and merge the counts into
+    // `base`, a sorted matrix built with the same vocabulary and window. The
+    // merged records are also streamed into `sorted` in (i, j) order, so
+    // that they can serve as the base of the next update.
+    static void update(
+        const CoSink& sink,
+        const CoSink& sorted,
+        const CoRecs& base,
+        const std::vector<std::string>& files,
+        const Vocabulary& vocab,
+        unsigned long window = 10,
+        bool symmetric = true,
+        unsigned long threshold = 5000 * 5000,
+        bool shuffle = true,
+        double memory = 0,
+        const std::string& tmpdir = "./",
+        unsigned long threads = 1,
+        unsigned long seed = 0);
+};
+
+// Parameters a co-occurrence matrix depends on, used to decide whether a
+// persisted matrix can be reused
+struct CoMatrixKey {
+    std::uint64_t fingerprint = 0;
+    std::uint64_t window = 0;
+    std::uint64_t symmetric = 0;
+    std::uint64_t min_count = 0;
+    std::uint64_t vocab_size = 0;
+    std::uint64_t keep_case = 0;
+
+    bool operator==(const CoMatrixKey& x) const {
+        return fingerprint == x.fingerprint && window == x.window &&
+               symmetric == x.symmetric && min_count == x.min_count &&
+               vocab_size == x.vocab_size && keep_case == x.keep_case;
+    }
+    bool operator!=(const CoMatrixKey& x) const {
+        return !((*this) == x);
+    }
+};
+
+struct CoMatrixHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t record_size;
+    CoMatrixKey key;
+    std::uint64_t vocab;
+    std::uint64_t sorted;
+    std::uint64_t count;
+};
+
+// Versioned binary co-occurrence file: a fixed size header followed by the
+// packed records, which are memory mapped when loaded. The header records the
+// signature of the vocabulary the ids refer to.
+class CoMatrixFile {
+public:
+    static const std::uint32_t version = 3;
+
+    CoMatrixFile() = delete;
+
+    static void save(
+        const std::string& file,
+        const CoMatrixKey& key,
+        std::uint64_t vocab,
+        const CoRecs& cooccur,
+        bool sorted = false);
+    static bool match(
+        const std::string& file, const CoMatrixKey& key, std::uint64_t vocab);
+    static CoMatrixHeader header(const std::string& file);
+    static CoRecs load(const std::string& file);
+};
+
+// Write a co-occurrence file record by record, the header is completed and
+// the file moved into place by `close`
+class CoMatrixWriter {
+public:
+    CoMatrixWriter(
+        const std::string& file,
+        const CoMatrixKey& key,
+        std::uint64_t vocab,
+        bool sorted = false);
+    CoMatrixWriter(const CoMatrixWriter& other) = delete;
+
+    void write(const CoRec& record);
+    void close();
+
+private:
+    std::string file;
+    std::string tmp;
+    CoMatrixKey key;
+    std::uint64_t vocab;
+    bool sorted;
+    std::ofstream os;
+    std::vector<CoRec> buffer;
+    std::uint64_t count = 0;
 };
 
 #endif /* _SRC_COOCCUR_H_ */
@@ -0,0 +1,123 @@
+#include "encoder.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include "gzip.h"
+#include "tokenizer.h"
+#include "util.h"
+
+static const char id_magic[8] = {'G', 'L', 'O', 'V', 'E', 'I', 'D', '\0'};
+
+static bool read_header(const std::string& file, IdCorpusHeader& header) {
+    std::ifstream is(file, std::ios::binary);
+    if (!is.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        return false;
+    }
+    return std::equal(id_magic, id_magic + 8, header.magic) &&
+           header.version == IdCorpus::version &&
+           header.id_size == sizeof(std::uint32_t);
+}
+
+void IdCorpus::encode(
+    const std::string& file,
+    const std::vector<std::string>& inputs,
+    const Vocabulary& vocab,
+    const IdCorpusKey& key) {
+    IdCorpusHeader header;
+    std::copy(id_magic, id_magic + 8, header.magic);
+    header.version = version;
+    header.id_size = sizeof(std::uint32_t);
+    header.key = key;
+    header.vocab = signature(vocab);
+    header.count = 0;
+
+    // Write next to the target and move it into place once complete
+    std::string tmp = file + ".tmp";
+    std::ofstream os;
+    file::open(os, tmp, std::ios::binary);
+    os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    std::vector<std::uint32_t> buffer;
+    buffer.reserve(1 << 16);
+    auto put = [&](std::uint32_t id) {
+        buffer.push_back(id);
+        if (buffer.size() == buffer.capacity()) {
+            os.write(
+                reinterpret_cast<const char*>(buffer.data()),
+                buffer.size() * sizeof(std::uint32_t));
+            header.count += buffer.size();
+            buffer.clear();
+        }
+    };
+
+    auto tally = [&](const char* begin, const char* end) {
+        Tokenizer tokenizer(begin, end);
+        Token token;
+        Tokenizer::Event event;
+        while ((event = tokenizer.next(token)) != Tokenizer::END) {
+            if (event == Tokenizer::NEWLINE) {
+                put(newline);
+                continue;
+            }
+            std::size_t id;
+            put(vocab.find(token.data, token.size, id) ? id : oov);
+        }
+        // Lines never continue across files
+        put(newline);
+    };
+    for (const auto& input : inputs) {
+        if (GzipReader::detect(input)) {
+            GzipReader reader(input);
+            std::vector<char> block;
+            while (reader.next(block)) {
+                tally(block.data(), block.data() + block.size());
+            }
+        } else {
+            MappedFile corpus(input);
+            tally(corpus.begin(), corpus.end());
+        }
+    }
+    os.write(
+        reinterpret_cast<const char*>(buffer.data()),
+        buffer.size() * sizeof(std::uint32_t));
+    header.count += buffer.size();
+
+    os.seekp(0);
+    os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    os.close();
+    if (!os || std::rename(tmp.c_str(), file.c_str())) {
+        throw std::runtime_error("failed to write file: " + file);
+    }
+}
+
+bool IdCorpus::detect(const std::string& file) {
+    IdCorpusHeader header;
+    return read_header(file, header);
+}
+
+bool IdCorpus::match(const std::string& file, const IdCorpusKey& key) {
+    IdCorpusHeader header;
+    return read_header(file, header) && header.key == key;
+}
+
+IdCorpusHeader IdCorpus::header(const std::string& file) {
+    IdCorpusHeader header;
+    if (!read_header(file, header)) {
+        throw std::runtime_error("invalid encoded corpus: " + file);
+    }
+    return header;
+}
+
+std::uint64_t IdCorpus::signature(const Vocabulary& vocab) {
+    // FNV-1a over the words in id order
+    std::uint64_t hash = 14695981039346656037ull;
+    for (std::size_t i = 0; i != vocab.size(); ++i) {
+        std::string word = vocab[i];
+        for (std::size_t k = 0; k != word.size() + 1; ++k) {
+            hash = (hash ^ static_cast<unsigned char>(word.c_str()[k])) *
+                   1099511628211ull;
+        }
+    }
+    return hash;
+}
@@ -0,0 +1,58 @@
+#ifndef _SRC_ENCODER_H_
+#define _SRC_ENCODER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "vocabulary.h"
+
+// Parameters an encoded corpus was made with
+struct IdCorpusKey {
+    std::uint64_t fingerprint = 0;
+    std::uint64_t min_count = 0;
+    std::uint64_t vocab_size = 0;
+    std::uint64_t keep_case = 0;
+
+    bool operator==(const IdCorpusKey& x) const {
+        return fingerprint == x.fingerprint && min_count == x.min_count &&
+               vocab_size == x.vocab_size && keep_case == x.keep_case;
+    }
+    bool operator!=(const IdCorpusKey& x) const {
+        return !((*this) == x);
+    }
+};
+
+struct IdCorpusHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t id_size;
+    IdCorpusKey key;
+    std::uint64_t vocab;
+    std::uint64_t count;
+};
+
+// Corpus pre-tokenized into a stream of 32 bit vocabulary ids, with markers
+// for line breaks and OOV words. Counting co-occurrences from it skips all
+// the string processing.
+class IdCorpus {
+public:
+    static const std::uint32_t version = 1;
+    static const std::uint32_t newline = 0xFFFFFFFF;
+    static const std::uint32_t oov = 0xFFFFFFFE;
+
+    IdCorpus() = delete;
+
+    static void encode(
+        const std::string& file,
+        const std::vector<std::string>& inputs,
+        const Vocabulary& vocab,
+        const IdCorpusKey& key);
+    static bool detect(const std::string& file);
+    static bool match(const std::string& file, const IdCorpusKey& key);
+    static IdCorpusHeader header(const std::string& file);
+
+    // Identity of the id assignment of a vocabulary
+    static std::uint64_t signature(const Vocabulary& vocab);
+};
+
+#endif /* _SRC_ENCODER_H_ */
@@ -1,180 +1,457 @@
 #include "glove.h"
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <cereal/archives/binary.hpp>
 #include <fstream>
+#include <future>
 #include <iomanip>
+#include <memory>
+#include <random>
+#include <stdexcept>
 #include <string>
-#include <thread>
+#include "kernel.h"
+#include "perf.h"
 #include "serialization.h"
+#include "topology.h"
 #include "util.h"
 
-GloVe::GloVe(
+static std::size_t gcd(std::size_t a, std::size_t b) {
+    while (b) {
+        a %= b;
+        std::swap(a, b);
+    }
+    return a;
+}
+
+std::vector<ChunkVisit> visit_chunks(
+    std::size_t begin,
+    std::size_t end,
+    std::size_t chunk,
+    bool reshuffle,
+    std::mt19937_64& rng) {
+    std::vector<ChunkVisit> visits;
+    for (std::size_t b = begin; b < end; b += chunk) {
+        ChunkVisit visit = {b, std::min(chunk, end - b), 0, 1};
+        if (reshuffle) {
+            visit.start = rng() % visit.size;
+            visit.step = rng() % visit.size;
+            while (gcd(visit.step, visit.size) != 1) {
+                visit.step = (visit.step + 1) % visit.size;
+            }
+        }
+        visits.push_back(visit);
+    }
+    if (reshuffle) {
+        std::shuffle(visits.begin(), visits.end(), rng);
+    }
+    return visits;
+}
+
+std::uint64_t holdout_cut(double holdout) {
+    if (holdout >= 1) {
+        return ~std::uint64_t(0);
+    }
+    return holdout > 0 ? std::uint64_t(holdout * 18446744073709551616.0) : 0;
+}
+
+bool held_out(const CoRec& record, std::uint64_t cut) {
+    std::uint64_t key = (std::uint64_t(record.i) << 32) | record.j;
+    return key * 0x9E3779B97F4A7C15ull < cut;
+}
+
+// Append the statistics of a worker in an epoch as a JSON line, unavailable
+// counters are null
+static void log_perf(
+    std::ostream& os,
+    unsigned long epoch,
+    std::size_t thread,
+    double seconds,
+    std::size_t records,
+    std::size_t bytes,
+    const PerfCounters& counters) {
+    auto value = [](std::int64_t x) {
+        return x < 0 ? std::string("null") : std::to_string(x);
+    };
+    std::int64_t cycles = counters.read(PerfCounters::CYCLES);
+    std::int64_t instructions = counters.read(PerfCounters::INSTRUCTIONS);
+    os << "{\"epoch\":" << epoch << ",\"thread\":" << thread
+       << ",\"seconds\":" << seconds << ",\"records\":" << records
+       << ",\"records_per_sec\":" << records / std::max(seconds, 1e-9)
+       << ",\"bytes\":" << bytes << ",\"cycles\":" << value(cycles)
+       << ",\"instructions\":" << value(instructions) << ",\"ipc\":"
+       << (cycles > 0 && instructions >= 0
+               ? std::to_string(double(instructions) / cycles)
+               : std::string("null"))
+       << ",\"cache_misses\":"
+       << value(counters.read(PerfCounters::CACHE_MISSES))
+       << ",\"dtlb_misses\":"
+       << value(counters.read(PerfCounters::DTLB_MISSES)) << "}" << std::endl;
+}
+
+template <typename T>
+BasicGloVe<T>::BasicGloVe(
     std::size_t vocab_size,
     unsigned long size,
     double scale,
     double alpha,
-    double threshold)
-    : vocab_size(vocab_size), size(size), alpha(alpha), threshold(threshold) {
-    // Params
-    W1 = arma::randn(vocab_size, size);
-    W2 = arma::randn(vocab_size, size);
-    b1 = arma::zeros(vocab_size);
-    b2 = arma::zeros(vocab_size);
-    W1 *= scale;
-    W2 *= scale;
-
-    // Gradients
-    dW1 = arma::zeros(vocab_size, size);
-    dW2 = arma::zeros(vocab_size, size);
-    db1 = arma::zeros(vocab_size);
-    db2 = arma::zeros(vocab_size);
-
-    // Gradient history
-    GW1 = arma::zeros(arma::size(W1));
-    GW2 = arma::zeros(arma::size(W2));
-    Gb1 = arma::zeros(arma::size(b1));
-    Gb2 = arma::zeros(arma::size(b1));
+    double threshold,
+    const OptimizerOptions& options)
+    : vocab_size(vocab_size),
+      size(size),
+      alpha(alpha),
+      threshold(threshold),
+      optimizer(Optimizer<T>::create(options)) {
+    // Biases and optimizer states start at zero
+    W1 = WordParams<T>(vocab_size, size, optimizer->states());
+    W2 = WordParams<T>(vocab_size, size, optimizer->states());
+    for (WordParams<T>* params : {&W1, &W2}) {
+        for (std::size_t i = 0; i != vocab_size; ++i) {
+            Col init = arma::randn<Col>(size) * T(scale);
+            std::copy(init.begin(), init.end(), params->vector(i));
+        }
+    }
 }
 
-void GloVe::train(
-    const CoRecs& cooccur,
-    unsigned long epochs,
-    double lr,
-    unsigned long threads,
-    const std::string& logdir,
-    unsigned long init_epoch,
-    unsigned long chkpt_freq) {
-    unsigned long num_per_thread = std::ceil(cooccur.size() / threads);
-
-    std::vector<std::thread> vec_threads(threads);
-    std::vector<double> partial_loss(threads);
-    for (unsigned long epoch = init_epoch; epoch != epochs; ++epoch) {
+template <typename T>
+void BasicGloVe<T>::train(const CoRecs& cooccur, const TrainOptions& options) {
+    // Records are handed out in small chunks so that slow threads do not
+    // hold up the epoch, each thread sums its loss in its own cache line
+    const std::size_t chunk = 1 << 12;
+    struct alignas(64) PaddedLoss {
+        double value;
+        std::size_t count;
+        double seconds;
+    };
+
+    // A `holdout` share of the records is held out of training
+    cut = holdout_cut(options.holdout);
+    double best = 0;
+    unsigned long stale = 0;
+
+    // Records of a node and the next of its chunks to be trained
+    struct alignas(64) Slice {
+        std::atomic<std::size_t> cursor;
+        std::size_t begin;
+        std::size_t end;
+    };
+
+    // With NUMA placement the workers are spread over the nodes and pinned,
+    // the parameters are interleaved over all nodes as words are accessed at
+    // random, and the records are split into one slice per node, stored in
+    // its memory. Workers drain the slice of their node before helping out
+    // with the others.
+    std::vector<int> nodes =
+        options.numa ? NumaTopology::nodes() : std::vector<int>{0};
+    std::vector<Slice, AlignedAllocator<Slice>> slices(nodes.size());
+    for (std::size_t n = 0; n != nodes.size(); ++n) {
+        slices[n].begin = cooccur.size() * n / nodes.size();
+        slices[n].end = cooccur.size() * (n + 1) / nodes.size();
+    }
+
+    WorkerPool pool(options.threads);
+    auto home = [&](std::size_t k) {
+        return k * nodes.size() / options.threads;
+    };
+    if (options.numa) {
+        std::cout << "NUMA nodes: " << nodes.size() << std::endl;
+        pool.run([&](std::size_t k) { NumaTopology::run_on(nodes[home(k)]); });
+        NumaTopology::interleave(W1.memptr(), W1.bytes());
+        NumaTopology::interleave(W2.memptr(), W2.bytes());
+        for (std::size_t n = 0; n != nodes.size(); ++n) {
+            NumaTopology::bind(
+                cooccur.data() + slices[n].begin,
+                sizeof(CoRec) * (slices[n].end - slices[n].begin), nodes[n]);
+        }
+    }
+
+    // The chunks of every slice in visiting order, see `visit_chunks`. The
+    // order of the next epoch is drawn on a background thread while the
+    // current one trains, seeded by the epoch so that resumed runs are
+    // reproducible.
+    using Order = std::vector<std::vector<ChunkVisit>>;
+    unsigned long seed =
+        options.seed ? options.seed : std::random_device()();
+    auto order = [&](unsigned long epoch) {
+        Order visits(slices.size());
+        std::seed_seq seq{seed, epoch};
+        std::mt19937_64 rng(seq);
+        for (std::size_t n = 0; n != slices.size(); ++n) {
+            visits[n] = visit_chunks(
+                slices[n].begin, slices[n].end, chunk, options.reshuffle,
+                rng);
+        }
+        return visits;
+    };
+    Order current = order(options.init_epoch);
+    std::future<Order> next;
+
+    // Hardware counters of every worker, opened on its own thread, with the
+    // statistics appended to perf.jsonl in the log directory every epoch
+    std::vector<std::unique_ptr<PerfCounters>> counters(
+        options.perf ? options.threads : 0);
+    std::ofstream perf_log;
+    if (options.perf) {
+        pool.run([&](std::size_t k) { counters[k].reset(new PerfCounters()); });
+        file::open(
+            perf_log, path::join(options.logdir, "perf.jsonl"),
+            std::ios::app);
+    }
+
+    // Checkpoints are written from a snapshot on a background thread while
+    // training goes on, at most one at a time
+    std::future<void> checkpoint;
+
+    std::vector<PaddedLoss, AlignedAllocator<PaddedLoss>> partial_loss(
+        options.threads);
+    std::vector<PaddedLoss, AlignedAllocator<PaddedLoss>> heldout_loss(
+        options.threads);
+    for (unsigned long epoch = options.init_epoch; epoch != options.epochs;
+         ++epoch) {
         Timer timer;
         timer.start();
-        vec_threads.clear();
-        CoRecs::const_iterator iter = cooccur.begin(), begin, end;
-        for (std::size_t i = 0; i != threads; ++i) {
-            begin = iter;
-            end =
-                (i != threads - 1 ? std::next(begin, num_per_thread + 1)
-                                  : cooccur.end());
-            vec_threads.emplace_back(
-                &GloVe::train_thread, this, std::ref(cooccur), begin, end,
-                std::ref(partial_loss[i]), lr);
-            iter = end;
+        // Learning rate decays with the inverse of time
+        double epoch_lr = options.lr / (1 + options.lr_decay * epoch);
+        if (next.valid()) {
+            current = next.get();
+        }
+        if (options.reshuffle && epoch + 1 != options.epochs) {
+            next = std::async(std::launch::async, order, epoch + 1);
         }
 
-        std::for_each(
-            vec_threads.begin(), vec_threads.end(),
-            [](std::thread& t) { return t.join(); });
+        for (auto& slice : slices) {
+            slice.cursor = 0;
+        }
+        pool.run([&](std::size_t k) {
+            Timer worker;
+            worker.start();
+            if (options.perf) {
+                counters[k]->start();
+            }
+            double& loss = partial_loss[k].value;
+            std::size_t& count = partial_loss[k].count;
+            loss = 0;
+            count = 0;
+            for (std::size_t n = 0; n != slices.size(); ++n) {
+                std::size_t s = (home(k) + n) % slices.size();
+                const std::vector<ChunkVisit>& visits = current[s];
+                std::size_t p;
+                while ((p = slices[s].cursor.fetch_add(1)) < visits.size()) {
+                    const ChunkVisit& visit = visits[p];
+                    loss += train_chunk(
+                        cooccur.data() + visit.begin, visit.size, visit.start,
+                        visit.step, epoch_lr, count);
+                }
+            }
+            if (options.perf) {
+                counters[k]->stop();
+            }
+            worker.stop();
+            partial_loss[k].seconds = worker.elapsed();
+        });
 
-        double loss =
-            std::accumulate(partial_loss.begin(), partial_loss.end(), 0.0) /
-            cooccur.size();
+        // Evaluate the held-out records read-only, in parallel
+        std::size_t heldout = 0;
+        double heldout_mean = 0;
+        if (cut) {
+            std::atomic<std::size_t> cursor(0);
+            pool.run([&](std::size_t k) {
+                PaddedLoss& partial = heldout_loss[k];
+                partial.value = 0;
+                partial.count = 0;
+                std::size_t begin;
+                while ((begin = cursor.fetch_add(chunk)) < cooccur.size()) {
+                    std::size_t end = std::min(begin + chunk, cooccur.size());
+                    partial.value += evaluate_chunk(
+                        cooccur.data() + begin, end - begin, partial.count);
+                }
+            });
+            for (const auto& partial : heldout_loss) {
+                heldout_mean += partial.value;
+                heldout += partial.count;
+            }
+            heldout_mean /= std::max(heldout, std::size_t(1));
+        }
+
+        double loss = 0;
+        for (const auto& partial : partial_loss) {
+            loss += partial.value;
+        }
+        loss /= std::max(cooccur.size() - heldout, std::size_t(1));
 
         timer.stop();
         std::cout << std::fixed << "Epoch " << std::setw(3) << epoch
                   << " (took:  " << std::setprecision(3) << timer.elapsed()
-                  << "s): Loss: " << std::setprecision(6) << loss << std::endl;
+                  << "s): Loss: " << std::setprecision(6) << loss;
+        if (cut) {
+            std::cout << ", Held-out loss: " << heldout_mean;
+        }
+        std::cout << std::endl;
+
+        // Bytes are estimated from the record and the two word blocks each
+        // record reads and writes
+        std::size_t block = W1.bytes() / std::max(W1.words(), std::size_t(1));
+        for (std::size_t k = 0; k != counters.size(); ++k) {
+            const PaddedLoss& partial = partial_loss[k];
+            log_perf(
+                perf_log, epoch, k, partial.seconds, partial.count,
+                partial.count * (sizeof(CoRec) + 2 * block), *counters[k]);
+        }
 
-        if (!((epoch + 1) % chkpt_freq) || !epoch) {
-            std::string chkpt = "glove." + std::to_string(vocab_size) + "." +
+        // Stop once the held-out loss improved by less than `tolerance`
+        // relatively for `patience` epochs in a row
+        bool stop = false;
+        if (cut && options.patience) {
+            if (epoch == options.init_epoch ||
+                best - heldout_mean > options.tolerance * best) {
+                stale = 0;
+            } else {
+                ++stale;
+            }
+            best = epoch == options.init_epoch ? heldout_mean
+                                       : std::min(best, heldout_mean);
+            if (stale >= options.patience && epoch + 1 != options.epochs) {
+                std::cout << "Held-out loss converged, stopping early"
+                          << std::endl;
+                stop = true;
+            }
+        }
+
+        if (!((epoch + 1) % options.chkpt_freq) || !epoch || stop) {
+            std::string chkpt = options.logdir + "glove." +
+                                std::to_string(vocab_size) + "." +
                                 std::to_string(size) + "." +
                                 std::to_string(epoch);
-            BinaryArchiver::save(logdir + chkpt, *this);
+            if (checkpoint.valid()) {
+                checkpoint.get();
+            }
+            auto snapshot = std::make_shared<BasicGloVe>(*this);
+            checkpoint = std::async(
+                std::launch::async, [snapshot, chkpt]() {
+                    BinaryArchiver::save(chkpt, *snapshot);
+                });
         }
+        if (stop) {
+            break;
+        }
+    }
+    if (checkpoint.valid()) {
+        checkpoint.get();
     }
     return;
 }
 
-double GloVe::train_thread(
-    const CoRecs& cooccur,
-    CoRecs::const_iterator begin,
-    CoRecs::const_iterator end,
-    double& loss,
-    double lr) {
-    loss = 0.0;
-
-    arma::rowvec dw1 = arma::zeros<arma::rowvec>(size);
-    arma::rowvec dw2 = arma::zeros<arma::rowvec>(size);
-    double db1 = 0;
-    double db2 = 0;
-
+template <typename T>
+double BasicGloVe<T>::train_chunk(
+    const CoRec* records,
+    std::size_t num,
+    std::size_t start,
+    std::size_t step,
+    double lr,
+    std::size_t& count) {
+    // Vectors are updated in place by the fused kernels of the optimizer,
+    // which never touch the heap
+    double loss = 0.0;
     double value, weight, sigma, l;
-    for (auto iter = begin; iter != end; ++iter) {
+    std::size_t k = start;
+    for (std::size_t m = 0; m != num; ++m) {
+        const CoRec* iter = records + k;
+        k += step;
+        if (k >= num) {
+            k -= num;
+        }
+        if (cut && held_out(*iter, cut)) {
+            continue;
+        }
         arma::uword i = iter->i, j = iter->j;
+        T* w1 = W1.vector(i);
+        T* w2 = W2.vector(j);
+        T& b1 = W1.bias(i);
+        T& b2 = W2.bias(j);
         value = iter->weight;
         weight = weighted(value);
-        sigma = difference(W1.row(i), W2.row(j), b1(i), b2(j), std::log(value));
-        l = 0.5 * weight * std::pow(sigma, 2);
+        sigma = kernel.dot(w1, w2, size) + b1 + b2 - std::log(value);
+        l = 0.5 * weight * sigma * sigma;
         loss += l;
         sigma *= weight;
 
-        dw1 = sigma * W2.row(j);
-        dw2 = sigma * W1.row(i);
-        db1 = sigma;
-        db2 = sigma;
-
 #ifndef NDEBUG
         // Check gradient will failed in a multiple threads setting
+        Row u(w1, size), v(w2, size);
         bool success = check_gradient(
-            value, l, W1.row(i), W2.row(j), b1(i), b2(j), dw1, dw2, db1, db2);
+            value, l, u, v, b1, b2, T(sigma) * v, T(sigma) * u, sigma,
+            sigma);
         if (!success) {
             std::cerr << "Gradient check failed." << std::endl;
         }
 #endif
 
-        GW1.row(i) += arma::square(dw1);
-        GW2.row(j) += arma::square(dw2);
-        Gb1(i) += db1 * db1;
-        Gb2(j) += db2 * db2;
-
-        W1.row(i) -= lr * dw1 / arma::sqrt(GW1.row(i) + 1e-8);
-        W2.row(j) -= lr * dw2 / arma::sqrt(GW2.row(j) + 1e-8);
-        b1(i) -= lr * db1 / std::sqrt(Gb1(i) + 1e-8);
-        b2(j) -= lr * db2 / std::sqrt(Gb2(j) + 1e-8);
+        optimizer->update(W1, i, W2, j, sigma, lr);
+        ++count;
     }
 
     return loss;
 }
 
-inline double GloVe::difference(
-    const arma::rowvec& w1,
-    const arma::rowvec& w2,
+template <typename T>
+double BasicGloVe<T>::evaluate_chunk(
+    const CoRec* records, std::size_t num, std::size_t& count) const {
+    double loss = 0.0;
+    for (const CoRec* iter = records; iter != records + num; ++iter) {
+        if (!held_out(*iter, cut)) {
+            continue;
+        }
+        arma::uword i = iter->i, j = iter->j;
+        double weight = weighted(iter->weight);
+        double sigma = kernel.dot(W1.vector(i), W2.vector(j), size) +
+                       W1.bias(i) + W2.bias(j) - std::log(iter->weight);
+        loss += 0.5 * weight * sigma * sigma;
+        ++count;
+    }
+    return loss;
+}
+
+template <typename T>
+inline double BasicGloVe<T>::difference(
+    const Row& w1,
+    const Row& w2,
     double b1,
     double b2,
     double gold) const {
     return arma::as_scalar(arma::dot(w1, w2)) + b1 + b2 - gold;
 }
 
-inline double GloVe::weighted(double cooccur) const {
+template <typename T>
+inline double BasicGloVe<T>::weighted(double cooccur) const {
     return std::min(std::pow(cooccur / threshold, alpha), 1.0);
 }
 
-inline double GloVe::single_loss(
+template <typename T>
+inline double BasicGloVe<T>::single_loss(
     double cooccur,
-    const arma::rowvec& w1,
-    const arma::rowvec& w2,
+    const Row& w1,
+    const Row& w2,
     double b1,
     double b2) const {
     return 0.5 * weighted(cooccur) *
            std::pow(difference(w1, w2, b1, b2, std::log(cooccur)), 2);
 }
 
-bool GloVe::check_gradient(
+template <typename T>
+bool BasicGloVe<T>::check_gradient(
     double cooccur,
     double loss,
-    const arma::rowvec& w1,
-    const arma::rowvec& w2,
+    const Row& w1,
+    const Row& w2,
     double b1,
     double b2,
-    const arma::rowvec& dw1,
-    const arma::rowvec& dw2,
+    const Row& dw1,
+    const Row& dw2,
     double db1,
     double db2,
     double eps) const {
-    arma::rowvec ndW1(arma::size(w1));
-    arma::rowvec ndW2(arma::size(w2));
+    Row ndW1(arma::size(w1));
+    Row ndW2(arma::size(w2));
     double ndb1, ndb2;
     double y1, y2;
 
@@ -208,18 +485,24 @@ bool GloVe::check_gradient(
     y2 = single_loss(cooccur, w1, w2, b1, b2 + eps);
     ndb2 = 0.5 * (y2 - y1) / eps;
 
-    return std::max({arma::max(arma::abs(dw1 - ndW1)),
-                     arma::max(arma::abs(dw2 - ndW2)), std::abs(db1 - ndb1),
-                     std::abs(db2 - ndb2)}) <= eps;
+    // Losses are computed at the precision of T, which limits the accuracy
+    // of the differences to about `eps` relative to the loss
+    return std::max({double(arma::max(arma::abs(dw1 - ndW1))),
+                     double(arma::max(arma::abs(dw2 - ndW2))),
+                     std::abs(db1 - ndb1), std::abs(db2 - ndb2)}) <=
+           eps * std::max(1.0, loss);
 }
 
-AnalogyPairs GloVe::most_similary(
+template <typename T>
+AnalogyPairs BasicGloVe<T>::most_similary(
     const std::string& word, unsigned long num, const Vocabulary& vocab) const {
     num = std::min(std::size_t(num), vocab.size());
 
-    arma::rowvec key = W1.row(vocab[word]);
-    arma::vec topk = W1 * key.t() / arma::sqrt(arma::sum(arma::square(W1), 1)) /
-                     arma::norm(key);
+    Mat vectors = W1.vectors();
+    Col key = vectors.col(vocab[word]);
+    Col topk = vectors.t() * key /
+               arma::sqrt(arma::sum(arma::square(vectors), 0)).t() /
+               arma::norm(key);
     arma::uvec indices = arma::sort_index(topk, "descend");
 
     AnalogyPairs words;
@@ -232,7 +515,8 @@ AnalogyPairs GloVe::most_similary(
     return words;
 }
 
-void GloVe::to_txt(const std::string& file, const Vocabulary& v) const {
+template <typename T>
+void BasicGloVe<T>::to_txt(const std::string& file, const Vocabulary& v) const {
     std::string meta = file + ".meta";
     std::string center = file + ".w1";
     std::string context = file + ".w2";
@@ -243,28 +527,48 @@ void GloVe::to_txt(const std::string& file, const Vocabulary& v) const {
     os.close();
 
     file::open(os, center);
-    for (std::size_t i = 0; i != W1.n_rows; ++i) {
+    for (std::size_t i = 0; i != W1.words(); ++i) {
         os << v[i] << " ";
-        W1.row(i).raw_print(os);
+        Row(W1.vector(i), size).raw_print(os);
     }
     os.close();
 
     file::open(os, context);
-    for (std::size_t i = 0; i != W2.n_rows; ++i) {
+    for (std::size_t i = 0; i != W2.words(); ++i) {
         os << v[i] << " ";
-        W2.row(i).raw_print(os);
+        Row(W2.vector(i), size).raw_print(os);
     }
     os.close();
 }
 
-void GloVe::serialize(cereal::BinaryOutputArchive& archive) {
-    archive(
-        vocab_size, size, alpha, threshold, W1, W2, b1, b2, dW1, dW2, db1, db2,
-        GW1, GW2, Gb1, Gb2);
+template <typename T>
+void BasicGloVe<T>::serialize(cereal::BinaryOutputArchive& archive) {
+    std::uint32_t precision = sizeof(T);
+    archive(precision);
+    OptimizerOptions options = optimizer->options();
+    archive(vocab_size, size, alpha, threshold, options, W1, W2);
 }
 
-void GloVe::serialize(cereal::BinaryInputArchive& archive) {
-    archive(
-        vocab_size, size, alpha, threshold, W1, W2, b1, b2, dW1, dW2, db1, db2,
-        GW1, GW2, Gb1, Gb2);
+template <typename T>
+void BasicGloVe<T>::serialize(cereal::BinaryInputArchive& archive) {
+    std::uint32_t precision = 0;
+    archive(precision);
+    if (precision != sizeof(T)) {
+        throw std::runtime_error(
+            "model precision mismatch: expected " +
+            std::to_string(8 * sizeof(T)) + " bit parameters, got " +
+            std::to_string(8 * precision));
+    }
+    OptimizerOptions options;
+    archive(vocab_size, size, alpha, threshold, options);
+    optimizer = Optimizer<T>::create(options);
+    archive(W1, W2);
+    if (W1.num_states() != optimizer->states() ||
+        W2.num_states() != optimizer->states()) {
+        throw std::runtime_error(
+            "model optimizer state mismatch for " + options.name);
+    }
 }
+
+template class BasicGloVe<double>;
+template class BasicGloVe<float>;
@@ -1,73 +1,150 @@
 #ifndef _SRC_GLOVE_H_
 #define _SRC_GLOVE_H_
 
+#include <algorithm>
 #include <armadillo>
 #include <cereal/archives/binary.hpp>
+#include <cmath>
+#include <cstdint>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
 #include <vector>
 #include "cooccur.h"
+#include "kernel.h"
+#include "optimizer.h"
+#include "params.h"
 #include "serialization.h"
 #include "vocabulary.h"
 
+// A chunk of `size` records from `begin`, walked from index `start` by
+// `step` modulo `size`
+struct ChunkVisit {
+    std::size_t begin;
+    std::size_t size;
+    std::size_t start;
+    std::size_t step;
+};
+
+// Chunks of `chunk` records covering [begin, end) in the order an epoch
+// trains them. When reshuffling, the chunks are permuted and each is walked
+// from a random start with a random stride coprime to its size, so that
+// every record is visited once in a new order.
+std::vector<ChunkVisit> visit_chunks(
+    std::size_t begin,
+    std::size_t end,
+    std::size_t chunk,
+    bool reshuffle,
+    std::mt19937_64& rng);
+
+// Records held out of training are a fixed share of the (i, j) pairs chosen
+// by hashing, `cut` out of 2^64, so the same records are held out in every
+// epoch and run
+std::uint64_t holdout_cut(double holdout);
+bool held_out(const CoRec& record, std::uint64_t cut);
+
+// Options of a training run
+struct TrainOptions {
+    unsigned long epochs = 10;
+    double lr = 1e-3;
+    // The learning rate of epoch t is lr / (1 + lr_decay * t)
+    double lr_decay = 0;
+    unsigned long threads = 12;
+    // Spread the workers, parameters and records over the NUMA nodes
+    bool numa = false;
+    // Visit the records in a new order every epoch, drawn from `seed`
+    bool reshuffle = false;
+    unsigned long seed = 0;
+    // Share of records held out, training stops once their loss improved by
+    // less than `tolerance` relatively for `patience` epochs in a row
+    double holdout = 0;
+    unsigned long patience = 0;
+    double tolerance = 1e-3;
+    // Append hardware counters of every worker to perf.jsonl in `logdir`
+    bool perf = false;
+    // Checkpoints are written to `logdir` every `chkpt_freq` epochs,
+    // resumed runs start at `init_epoch`
+    std::string logdir = "./";
+    unsigned long chkpt_freq = 1;
+    unsigned long init_epoch = 0;
+};
+
 using AnalogyPair = std::pair<std::string, double>;
 using AnalogyPairs = std::vector<std::pair<std::string, double>>;
 
-class GloVe {
+// GloVe model with parameters of type `T`, single precision halves the memory
+// traffic of training as well as the size of checkpoints
+template <typename T>
+class BasicGloVe {
 public:
-    GloVe() = default;
-    explicit GloVe(
+    using Mat = arma::Mat<T>;
+    using Row = arma::Row<T>;
+    using Col = arma::Col<T>;
+
+    BasicGloVe() = default;
+    explicit BasicGloVe(
         std::size_t vocab_size,
         unsigned long size = 200,
         double init_scale = 1e-3,
         double alpha = 3.0 / 4,
-        double threshold = 100);
-
-    void train(
-        const CoRecs& cooccur,
-        unsigned long epoch = 10,
-        double lr = 1e-3,
-        unsigned long threads = 12,
-        const std::string& logdir = "./",
-        unsigned long init_epoch = 0,
-        unsigned long chkpt_freq = 1);
-    double train_thread(
-        const CoRecs& cooccur,
-        CoRecs::const_iterator begin,
-        CoRecs::const_iterator end,
-        double& loss,
-        double lr);
+        double threshold = 100,
+        const OptimizerOptions& optimizer = OptimizerOptions());
+
+    void train(const CoRecs& cooccur, const TrainOptions& options);
+    // Train on `num` records, visiting index `start` first and then stepping
+    // by `step` modulo `num`, and return their loss. The records trained, not
+    // held out, are counted into `count`.
+    double train_chunk(
+        const CoRec* records,
+        std::size_t num,
+        std::size_t start,
+        std::size_t step,
+        double lr,
+        std::size_t& count);
+    // Loss of the held-out records among `num`, counting them into `count`
+    double evaluate_chunk(
+        const CoRec* records, std::size_t num, std::size_t& count) const;
     inline double difference(
-        const arma::rowvec& w1,
-        const arma::rowvec& w2,
+        const Row& w1,
+        const Row& w2,
         double b1,
         double b2,
         double gold) const;
     inline double weighted(double cooccur) const;
     inline double single_loss(
         double cooccur,
-        const arma::rowvec& w1,
-        const arma::rowvec& w2,
+        const Row& w1,
+        const Row& w2,
         double b1,
         double b2) const;
 
+    // Compare gradients with central differences, by default stepping at
+    // least the square root of the epsilon of T
     bool check_gradient(
         double cooccur,
         double loss,
-        const arma::rowvec& w1,
-        const arma::rowvec& w2,
+        const Row& w1,
+        const Row& w2,
         double b1,
         double b2,
-        const arma::rowvec& dw1,
-        const arma::rowvec& dw2,
+        const Row& dw1,
+        const Row& dw2,
         double db1,
         double db2,
-        double eps = 1e-7) const;
+        double eps = std::max(
+            1e-7, std::sqrt(double(std::numeric_limits<T>::epsilon())))) const;
 
     AnalogyPairs most_similary(
         const std::string& word,
         unsigned long num,
         const Vocabulary& vocab) const;
 
+    const OptimizerOptions& optimizer_options() const {
+        return optimizer->options();
+    }
+
     void to_txt(const std::string& file, const Vocabulary& vocab) const;
 
     void serialize(cereal::BinaryOutputArchive& archive);
@@ -78,18 +155,16 @@ private:
     unsigned long size;
     double alpha;
     double threshold;
-    arma::mat W1;
-    arma::mat W2;
-    arma::colvec b1;
-    arma::colvec b2;
-    arma::mat dW1;
-    arma::mat dW2;
-    arma::colvec db1;
-    arma::colvec db2;
-    arma::mat GW1;
-    arma::mat GW2;
-    arma::mat Gb1;
-    arma::mat Gb2;
+    // Center and context words with their biases and optimizer states
+    WordParams<T> W1;
+    WordParams<T> W2;
+    std::shared_ptr<const Optimizer<T>> optimizer;
+    TrainKernel<T> kernel = TrainKernel<T>::select();
+    // Records hashing below are held out of training
+    std::uint64_t cut = 0;
 };
 
+using GloVe = BasicGloVe<double>;
+using GloVe32 = BasicGloVe<float>;
+
 #endif /* _SRC_GLOVE_H_ */
@@ -0,0 +1,104 @@
+#include "gzip.h"
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+GzipReader::GzipReader(
+    const std::string& file, std::size_t block, std::size_t depth)
+    : file(file), block_size(block), depth(std::max(depth, std::size_t(1))) {
+    gz = gzopen(file.c_str(), "rb");
+    if (!gz) {
+        throw std::runtime_error("failed to open file: " + file);
+    }
+    gzbuffer(gz, 1 << 17);
+    worker = std::thread(&GzipReader::run, this);
+}
+
+GzipReader::~GzipReader() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    cv.notify_all();
+    worker.join();
+    gzclose(gz);
+}
+
+bool GzipReader::detect(const std::string& file) {
+    std::ifstream is(file, std::ios::binary);
+    char magic[2] = {0, 0};
+    is.read(magic, 2);
+    return is && magic[0] == '\x1f' && magic[1] == '\x8b';
+}
+
+bool GzipReader::next(std::vector<char>& block) {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [this]() { return !queue.empty() || done; });
+    if (queue.empty()) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        return false;
+    }
+    block = std::move(queue.front());
+    queue.pop_front();
+    cv.notify_all();
+    return true;
+}
+
+bool GzipReader::push(std::vector<char>& block) {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [this]() { return queue.size() < depth || stop; });
+    if (stop) {
+        return false;
+    }
+    queue.push_back(std::move(block));
+    cv.notify_all();
+    return true;
+}
+
+void GzipReader::run() {
+    try {
+        std::vector<char> carry;
+        for (;;) {
+            // Append to the partial line left by the previous block
+            std::vector<char> block(std::move(carry));
+            std::size_t used = block.size();
+            block.resize(used + block_size);
+            int n = gzread(gz, block.data() + used, block_size);
+            if (n < 0) {
+                int code;
+                throw std::runtime_error(
+                    "failed to decompress " + file + ": " + gzerror(gz, &code));
+            }
+            block.resize(used + n);
+            if (!n) {
+                if (!block.empty()) {
+                    push(block);
+                }
+                break;
+            }
+
+            // Keep the trailing partial line for the next block
+            auto last = std::find(block.rbegin(), block.rend(), '\n');
+            if (last == block.rend()) {
+                carry = std::move(block);
+                continue;
+            }
+            carry.assign(last.base(), block.end());
+            block.erase(last.base(), block.end());
+            if (!push(block)) {
+                break;
+            }
+        }
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex);
+        error = std::current_exception();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+    }
+    cv.notify_all();
+}
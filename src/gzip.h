@@ -0,0 +1,49 @@
+#ifndef _SRC_GZIP_H_
+#define _SRC_GZIP_H_
+
+#include <zlib.h>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Decompress a gzip file on a background thread. The output is cut into
+// blocks of complete lines which are handed over through a bounded queue, so
+// that decompression overlaps with tokenizing and no plain copy is needed.
+class GzipReader {
+public:
+    explicit GzipReader(
+        const std::string& file,
+        std::size_t block = 1 << 22,
+        std::size_t depth = 4);
+    GzipReader(const GzipReader& other) = delete;
+    ~GzipReader();
+
+    // Whether a file starts with the gzip magic bytes
+    static bool detect(const std::string& file);
+
+    // Take the next block, returns false once the file is exhausted. Safe to
+    // call from several threads.
+    bool next(std::vector<char>& block);
+
+private:
+    void run();
+    bool push(std::vector<char>& block);
+
+    std::string file;
+    gzFile gz;
+    std::size_t block_size;
+    std::size_t depth;
+    std::deque<std::vector<char>> queue;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool done = false;
+    bool stop = false;
+    std::exception_ptr error;
+    std::thread worker;
+};
+
+#endif /* _SRC_GZIP_H_ */
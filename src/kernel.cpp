@@ -0,0 +1,150 @@
+#include "kernel.h"
+#include <cmath>
+#include <stdexcept>
+
+// The loops are written once and inlined into functions compiled for each
+// instruction set, where they are vectorized by the compiler
+template <typename T>
+static inline __attribute__((always_inline)) T dot_loop(
+    const T* __restrict x, const T* __restrict y, std::size_t n) {
+    T sum = 0;
+    for (std::size_t k = 0; k != n; ++k) {
+        sum += x[k] * y[k];
+    }
+    return sum;
+}
+
+template <typename T>
+static inline __attribute__((always_inline)) void adagrad_loop(
+    T* __restrict w1,
+    T* __restrict g1,
+    T* __restrict w2,
+    T* __restrict g2,
+    T sigma,
+    T lr,
+    T eps,
+    std::size_t n) {
+    for (std::size_t k = 0; k != n; ++k) {
+        T d1 = sigma * w2[k];
+        T d2 = sigma * w1[k];
+        g1[k] += d1 * d1;
+        g2[k] += d2 * d2;
+        w1[k] -= lr * d1 / std::sqrt(g1[k] + eps);
+        w2[k] -= lr * d2 / std::sqrt(g2[k] + eps);
+    }
+}
+
+template <typename T>
+static inline __attribute__((always_inline)) void adam_loop(
+    T* __restrict w1,
+    T* __restrict m1,
+    T* __restrict v1,
+    T* __restrict w2,
+    T* __restrict m2,
+    T* __restrict v2,
+    T sigma,
+    T lr1,
+    T lr2,
+    T beta1,
+    T beta2,
+    T eps,
+    std::size_t n) {
+    for (std::size_t k = 0; k != n; ++k) {
+        T d1 = sigma * w2[k];
+        T d2 = sigma * w1[k];
+        m1[k] = beta1 * m1[k] + (1 - beta1) * d1;
+        m2[k] = beta1 * m2[k] + (1 - beta1) * d2;
+        v1[k] = beta2 * v1[k] + (1 - beta2) * d1 * d1;
+        v2[k] = beta2 * v2[k] + (1 - beta2) * d2 * d2;
+        w1[k] -= lr1 * m1[k] / (std::sqrt(v1[k]) + eps);
+        w2[k] -= lr2 * m2[k] / (std::sqrt(v2[k]) + eps);
+    }
+}
+
+template <typename T>
+static inline __attribute__((always_inline)) void sgd_loop(
+    T* __restrict w1, T* __restrict w2, T sigma, T lr, std::size_t n) {
+    for (std::size_t k = 0; k != n; ++k) {
+        T d1 = sigma * w2[k];
+        T d2 = sigma * w1[k];
+        w1[k] -= lr * d1;
+        w2[k] -= lr * d2;
+    }
+}
+
+// Define the kernels of an instruction set with the given attributes
+#define GLOVE_KERNELS(isa, attributes)                                     \
+    template <typename T>                                                  \
+    attributes static T dot_##isa(const T* x, const T* y, std::size_t n) { \
+        return dot_loop(x, y, n);                                          \
+    }                                                                      \
+    template <typename T>                                                  \
+    attributes static void adagrad_##isa(                                  \
+        T* w1, T* g1, T* w2, T* g2, T sigma, T lr, T eps, std::size_t n) { \
+        adagrad_loop(w1, g1, w2, g2, sigma, lr, eps, n);                   \
+    }                                                                      \
+    template <typename T>                                                  \
+    attributes static void adam_##isa(                                     \
+        T* w1, T* m1, T* v1, T* w2, T* m2, T* v2, T sigma, T lr1, T lr2,   \
+        T beta1, T beta2, T eps, std::size_t n) {                          \
+        adam_loop(                                                         \
+            w1, m1, v1, w2, m2, v2, sigma, lr1, lr2, beta1, beta2, eps,    \
+            n);                                                            \
+    }                                                                      \
+    template <typename T>                                                  \
+    attributes static void sgd_##isa(                                      \
+        T* w1, T* w2, T sigma, T lr, std::size_t n) {                      \
+        sgd_loop(w1, w2, sigma, lr, n);                                    \
+    }
+
+#define GLOVE_KERNEL(isa) \
+    { dot_##isa<T>, adagrad_##isa<T>, adam_##isa<T>, sgd_##isa<T>, #isa }
+
+GLOVE_KERNELS(generic, )
+
+#if defined(__GNUC__) && defined(__x86_64__)
+GLOVE_KERNELS(
+    avx512,
+    __attribute__((target(
+        "avx512f,avx512dq,avx512vl,avx2,fma,prefer-vector-width=512"))))
+GLOVE_KERNELS(avx2, __attribute__((target("avx2,fma"))))
+#endif
+
+template <typename T>
+TrainKernel<T> TrainKernel<T>::select() {
+#if defined(__GNUC__) && defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") &&
+        __builtin_cpu_supports("avx512dq") &&
+        __builtin_cpu_supports("avx512vl")) {
+        return select("avx512");
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return select("avx2");
+    }
+#endif
+    return select("generic");
+}
+
+template <typename T>
+TrainKernel<T> TrainKernel<T>::select(const std::string& isa) {
+    if (isa == "generic") {
+        return GLOVE_KERNEL(generic);
+    }
+#if defined(__GNUC__) && defined(__x86_64__)
+    __builtin_cpu_init();
+    if (isa == "avx512" && __builtin_cpu_supports("avx512f") &&
+        __builtin_cpu_supports("avx512dq") &&
+        __builtin_cpu_supports("avx512vl")) {
+        return GLOVE_KERNEL(avx512);
+    }
+    if (isa == "avx2" && __builtin_cpu_supports("avx2") &&
+        __builtin_cpu_supports("fma")) {
+        return GLOVE_KERNEL(avx2);
+    }
+#endif
+    throw std::runtime_error("unsupported instruction set: " + isa);
+}
+
+template struct TrainKernel<float>;
+template struct TrainKernel<double>;
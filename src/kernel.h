@@ -0,0 +1,46 @@
+#ifndef _SRC_KERNEL_H_
+#define _SRC_KERNEL_H_
+
+#include <cstddef>
+#include <string>
+
+// Inner loops of training on contiguous word vectors of length `n`. They are
+// compiled for AVX-512, AVX2 and generic x86/other targets, and the best one
+// the CPU supports is picked at runtime. The updates step both word vectors
+// of a record in one pass given its weighted error `sigma`, the gradient of
+// each vector being `sigma` times the other one.
+template <typename T>
+struct TrainKernel {
+    // Dot product of two word vectors
+    T (*dot)(const T* x, const T* y, std::size_t n);
+    // AdaGrad, squared gradients are accumulated into `g1`/`g2`
+    void (*adagrad)(
+        T* w1, T* g1, T* w2, T* g2, T sigma, T lr, T eps, std::size_t n);
+    // Adam with the moments in `m1`/`v1` and `m2`/`v2`, the step sizes
+    // `lr1`/`lr2` include the bias correction of each word
+    void (*adam)(
+        T* w1,
+        T* m1,
+        T* v1,
+        T* w2,
+        T* m2,
+        T* v2,
+        T sigma,
+        T lr1,
+        T lr2,
+        T beta1,
+        T beta2,
+        T eps,
+        std::size_t n);
+    // Plain gradient descent
+    void (*sgd)(T* w1, T* w2, T sigma, T lr, std::size_t n);
+    // Instruction set of the kernel
+    const char* isa;
+
+    // Best kernel for the running CPU
+    static TrainKernel select();
+    // Kernel for an instruction set, throws if the CPU lacks it
+    static TrainKernel select(const std::string& isa);
+};
+
+#endif /* _SRC_KERNEL_H_ */
@@ -0,0 +1,113 @@
+#include "optimizer.h"
+#include <cmath>
+#include <stdexcept>
+
+template <typename T>
+class AdaGrad : public Optimizer<T> {
+public:
+    explicit AdaGrad(const OptimizerOptions& options)
+        : Optimizer<T>(options) {}
+
+    std::size_t states() const override { return 1; }
+
+    void update(
+        WordParams<T>& W1,
+        std::size_t i,
+        WordParams<T>& W2,
+        std::size_t j,
+        double sigma,
+        double lr) const override {
+        double eps = this->opts.eps;
+        this->kernel.adagrad(
+            W1.vector(i), W1.state(i, 0), W2.vector(j), W2.state(j, 0),
+            T(sigma), T(lr), T(eps), W1.dimension());
+        T& g1 = W1.bias_state(i, 0);
+        T& g2 = W2.bias_state(j, 0);
+        g1 += sigma * sigma;
+        g2 += sigma * sigma;
+        W1.bias(i) -= lr * sigma / std::sqrt(g1 + eps);
+        W2.bias(j) -= lr * sigma / std::sqrt(g2 + eps);
+    }
+};
+
+// Lazy Adam: the moments of a word only decay when it is trained, and the
+// bias correction uses the number of updates of the word
+template <typename T>
+class Adam : public Optimizer<T> {
+public:
+    explicit Adam(const OptimizerOptions& options) : Optimizer<T>(options) {}
+
+    std::size_t states() const override { return 2; }
+
+    void update(
+        WordParams<T>& W1,
+        std::size_t i,
+        WordParams<T>& W2,
+        std::size_t j,
+        double sigma,
+        double lr) const override {
+        double beta1 = this->opts.beta1, beta2 = this->opts.beta2;
+        double eps = this->opts.eps;
+        double lr1 = step(W1.steps(i), lr), lr2 = step(W2.steps(j), lr);
+        this->kernel.adam(
+            W1.vector(i), W1.state(i, 0), W1.state(i, 1), W2.vector(j),
+            W2.state(j, 0), W2.state(j, 1), T(sigma), T(lr1), T(lr2),
+            T(beta1), T(beta2), T(eps), W1.dimension());
+        bias(W1.bias(i), W1.bias_state(i, 0), W1.bias_state(i, 1), sigma, lr1);
+        bias(W2.bias(j), W2.bias_state(j, 0), W2.bias_state(j, 1), sigma, lr2);
+    }
+
+private:
+    void bias(T& b, T& m, T& v, double sigma, double lr) const {
+        double beta1 = this->opts.beta1, beta2 = this->opts.beta2;
+        m = beta1 * m + (1 - beta1) * sigma;
+        v = beta2 * v + (1 - beta2) * sigma * sigma;
+        b -= lr * m / (std::sqrt(v) + this->opts.eps);
+    }
+
+    // Count an update of a word and return its bias corrected step size
+    double step(std::uint64_t& steps, double lr) const {
+        double t = ++steps;
+        return lr * std::sqrt(1 - std::pow(this->opts.beta2, t)) /
+               (1 - std::pow(this->opts.beta1, t));
+    }
+};
+
+template <typename T>
+class SGD : public Optimizer<T> {
+public:
+    explicit SGD(const OptimizerOptions& options) : Optimizer<T>(options) {}
+
+    std::size_t states() const override { return 0; }
+
+    void update(
+        WordParams<T>& W1,
+        std::size_t i,
+        WordParams<T>& W2,
+        std::size_t j,
+        double sigma,
+        double lr) const override {
+        this->kernel.sgd(
+            W1.vector(i), W2.vector(j), T(sigma), T(lr), W1.dimension());
+        W1.bias(i) -= lr * sigma;
+        W2.bias(j) -= lr * sigma;
+    }
+};
+
+template <typename T>
+std::shared_ptr<const Optimizer<T>> Optimizer<T>::create(
+    const OptimizerOptions& options) {
+    if (options.name == "adagrad") {
+        return std::make_shared<AdaGrad<T>>(options);
+    }
+    if (options.name == "adam") {
+        return std::make_shared<Adam<T>>(options);
+    }
+    if (options.name == "sgd") {
+        return std::make_shared<SGD<T>>(options);
+    }
+    throw std::invalid_argument("unknown optimizer: " + options.name);
+}
+
+template class Optimizer<float>;
+template class Optimizer<double>;
@@ -0,0 +1,61 @@
+#ifndef _SRC_OPTIMIZER_H_
+#define _SRC_OPTIMIZER_H_
+
+#include <cereal/archives/binary.hpp>
+#include <cereal/types/string.hpp>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include "kernel.h"
+#include "params.h"
+
+// Settings of an optimizer, stored in checkpoints
+struct OptimizerOptions {
+    // adagrad, adam (lazy, only the moments of trained words decay) or sgd
+    std::string name = "adagrad";
+    double beta1 = 0.9;
+    double beta2 = 0.999;
+    double eps = 1e-8;
+
+    template <class Archive>
+    void serialize(Archive& archive) {
+        archive(name, beta1, beta2, eps);
+    }
+};
+
+// Update rule for the pair of words of a record. Optimizer state lives in the
+// word blocks, `states()` values per parameter, so an optimizer is stateless
+// and shared by all threads.
+template <typename T>
+class Optimizer {
+public:
+    virtual ~Optimizer() = default;
+
+    // Number of states of each parameter
+    virtual std::size_t states() const = 0;
+
+    // Step word `i` of `W1` and word `j` of `W2` for the weighted error
+    // `sigma` with learning rate `lr`
+    virtual void update(
+        WordParams<T>& W1,
+        std::size_t i,
+        WordParams<T>& W2,
+        std::size_t j,
+        double sigma,
+        double lr) const = 0;
+
+    const OptimizerOptions& options() const { return opts; }
+
+    // Throws for an unknown optimizer name
+    static std::shared_ptr<const Optimizer> create(
+        const OptimizerOptions& options);
+
+protected:
+    explicit Optimizer(const OptimizerOptions& options)
+        : opts(options), kernel(TrainKernel<T>::select()) {}
+
+    OptimizerOptions opts;
+    TrainKernel<T> kernel;
+};
+
+#endif /* _SRC_OPTIMIZER_H_ */
@@ -0,0 +1,101 @@
+#include "params.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+template <typename T>
+constexpr std::size_t WordParams<T>::alignment;
+
+template <typename T>
+WordParams<T>::WordParams(
+    std::size_t words, std::size_t size, std::size_t states) {
+    allocate(words, size, states);
+}
+
+template <typename T>
+WordParams<T>::WordParams(const WordParams& other) {
+    allocate(other.num, other.size, other.states);
+    std::memcpy(data, other.data, bytes());
+}
+
+template <typename T>
+WordParams<T>::WordParams(WordParams&& other)
+    : data(other.data),
+      num(other.num),
+      size(other.size),
+      states(other.states),
+      stride(other.stride),
+      offset(other.offset) {
+    other.data = nullptr;
+    other.num = other.size = other.states = other.stride = other.offset = 0;
+}
+
+template <typename T>
+WordParams<T>& WordParams<T>::operator=(WordParams&& other) {
+    std::swap(data, other.data);
+    std::swap(num, other.num);
+    std::swap(size, other.size);
+    std::swap(states, other.states);
+    std::swap(stride, other.stride);
+    std::swap(offset, other.offset);
+    return *this;
+}
+
+template <typename T>
+WordParams<T>::~WordParams() {
+    std::free(data);
+}
+
+template <typename T>
+void WordParams<T>::allocate(
+    std::size_t words, std::size_t size, std::size_t states) {
+    // Vector, states, bias and bias states, followed by the 64 bit number of
+    // updates at its natural alignment, rounded up to cache lines
+    std::size_t line = alignment / sizeof(T);
+    std::size_t slots = sizeof(std::uint64_t) / sizeof(T);
+    std::size_t steps =
+        ((states + 1) * size + states + 1 + slots - 1) / slots * slots;
+    std::size_t width = (steps + slots + line - 1) / line * line;
+    void* ptr = nullptr;
+    if (posix_memalign(&ptr, alignment, words * width * sizeof(T))) {
+        throw std::bad_alloc();
+    }
+    std::free(data);
+    data = static_cast<T*>(ptr);
+    num = words;
+    this->size = size;
+    this->states = states;
+    stride = width;
+    offset = steps;
+    std::memset(data, 0, bytes());
+}
+
+template <typename T>
+arma::Mat<T> WordParams<T>::vectors() const {
+    arma::Mat<T> mat(size, num);
+    for (std::size_t i = 0; i != num; ++i) {
+        std::copy(vector(i), vector(i) + size, mat.colptr(i));
+    }
+    return mat;
+}
+
+template <typename T>
+void WordParams<T>::serialize(cereal::BinaryOutputArchive& archive) {
+    std::uint64_t words = num, length = size, count = states;
+    archive(words, length, count);
+    archive(cereal::binary_data(data, sizeof(T) * num * stride));
+}
+
+template <typename T>
+void WordParams<T>::serialize(cereal::BinaryInputArchive& archive) {
+    std::uint64_t words = 0, length = 0, count = 0;
+    archive(words, length, count);
+    allocate(words, length, count);
+    archive(cereal::binary_data(data, sizeof(T) * num * stride));
+}
+
+template class WordParams<float>;
+template class WordParams<double>;
@@ -0,0 +1,66 @@
+#ifndef _SRC_PARAMS_H_
+#define _SRC_PARAMS_H_
+
+#include <armadillo>
+#include <cereal/archives/binary.hpp>
+#include <cstddef>
+#include <cstdint>
+
+// Word-major parameter store: the vector of a word, the `states` optimizer
+// states of the same length, its bias with as many states and the number of
+// its updates sit in one cache line aligned block, so training a word
+// touches contiguous memory only
+template <typename T>
+class WordParams {
+public:
+    static constexpr std::size_t alignment = 64;
+
+    WordParams() = default;
+    WordParams(std::size_t words, std::size_t size, std::size_t states = 1);
+    WordParams(const WordParams& other);
+    WordParams(WordParams&& other);
+    WordParams& operator=(WordParams&& other);
+    ~WordParams();
+
+    T* vector(std::size_t i) { return data + i * stride; }
+    const T* vector(std::size_t i) const { return data + i * stride; }
+    T* state(std::size_t i, std::size_t s) {
+        return vector(i) + (s + 1) * size;
+    }
+    T& bias(std::size_t i) { return vector(i)[(states + 1) * size]; }
+    T bias(std::size_t i) const { return vector(i)[(states + 1) * size]; }
+    T& bias_state(std::size_t i, std::size_t s) {
+        return vector(i)[(states + 1) * size + 1 + s];
+    }
+    // Number of updates, an integer so that it keeps counting beyond the
+    // precision of `T`
+    std::uint64_t& steps(std::size_t i) {
+        return *reinterpret_cast<std::uint64_t*>(vector(i) + offset);
+    }
+
+    std::size_t words() const { return num; }
+    std::size_t dimension() const { return size; }
+    std::size_t num_states() const { return states; }
+
+    // Storage of all blocks
+    const T* memptr() const { return data; }
+    std::size_t bytes() const { return sizeof(T) * num * stride; }
+
+    // Copy of the word vectors as columns of a matrix
+    arma::Mat<T> vectors() const;
+
+    void serialize(cereal::BinaryOutputArchive& archive);
+    void serialize(cereal::BinaryInputArchive& archive);
+
+private:
+    void allocate(std::size_t words, std::size_t size, std::size_t states);
+
+    T* data = nullptr;
+    std::size_t num = 0;
+    std::size_t size = 0;
+    std::size_t states = 0;
+    std::size_t stride = 0;
+    std::size_t offset = 0;
+};
+
+#endif /* _SRC_PARAMS_H_ */
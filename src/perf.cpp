@@ -0,0 +1,93 @@
+#include "perf.h"
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+#endif
+
+#ifdef __linux__
+static int open_event(std::uint32_t type, std::uint64_t config) {
+    struct perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format =
+        PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+PerfCounters::PerfCounters() {
+    for (int& fd : fds) {
+        fd = -1;
+    }
+#ifdef __linux__
+    fds[CYCLES] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    fds[INSTRUCTIONS] =
+        open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    fds[CACHE_MISSES] =
+        open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    fds[DTLB_MISSES] = open_event(
+        PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB |
+                                (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+#endif
+}
+
+PerfCounters::~PerfCounters() {
+#ifdef __linux__
+    for (int fd : fds) {
+        if (fd != -1) {
+            close(fd);
+        }
+    }
+#endif
+}
+
+void PerfCounters::start() {
+#ifdef __linux__
+    for (int fd : fds) {
+        if (fd != -1) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+#endif
+}
+
+void PerfCounters::stop() {
+#ifdef __linux__
+    for (int fd : fds) {
+        if (fd != -1) {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+#endif
+}
+
+std::int64_t PerfCounters::read(Event event) const {
+#ifdef __linux__
+    // Value, time enabled and time running
+    std::uint64_t values[3];
+    if (fds[event] == -1 ||
+        ::read(fds[event], values, sizeof(values)) != sizeof(values)) {
+        return -1;
+    }
+    if (!values[2] && values[1]) {
+        return -1;
+    }
+    if (values[2] && values[2] < values[1]) {
+        return std::int64_t(double(values[0]) * values[1] / values[2]);
+    }
+    return values[0];
+#else
+    static_cast<void>(event);
+    return -1;
+#endif
+}
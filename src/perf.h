@@ -0,0 +1,28 @@
+#ifndef _SRC_PERF_H_
+#define _SRC_PERF_H_
+
+#include <cstdint>
+
+// Hardware counters of the calling thread from perf_event_open, counting user
+// space only while started. Counters which the kernel, the CPU or the
+// permissions do not offer read as -1.
+class PerfCounters {
+public:
+    enum Event { CYCLES, INSTRUCTIONS, CACHE_MISSES, DTLB_MISSES, EVENTS };
+
+    PerfCounters();
+    PerfCounters(const PerfCounters& other) = delete;
+    ~PerfCounters();
+
+    // Reset and enable the counters
+    void start();
+    // Disable the counters, keeping their values
+    void stop();
+    // Value of a counter, scaled up if it was multiplexed
+    std::int64_t read(Event event) const;
+
+private:
+    int fds[EVENTS];
+};
+
+#endif /* _SRC_PERF_H_ */
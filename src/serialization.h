@@ -3,7 +3,10 @@
 
 #include <armadillo>
 #include <cereal/archives/binary.hpp>
+#include <cstdio>
+#include <fstream>
 #include <stdexcept>
+#include <string>
 #include "serialization.h"
 
 namespace cereal {
@@ -24,19 +27,35 @@ void load(Archive& archive, arma::Mat<T>& mat) {
 
 class BinaryArchiver {
 public:
+    // Write into a temporary file renamed over `file` once complete, so an
+    // interrupted save never destroys the previous contents
     template <typename T>
     static void save(const std::string& file, const T& obj) {
-        std::ofstream os;
-        auto old_state = os.exceptions();
-        try {
-            os.exceptions(std::ios::badbit | std::ios::failbit);
-            os.open(file, std::ios::binary);
-        } catch (const std::ios::failure& e) {
-            throw std::runtime_error("failed to open binary file: " + file);
+        std::string tmp = file + ".tmp";
+        {
+            std::ofstream os;
+            auto old_state = os.exceptions();
+            try {
+                os.exceptions(std::ios::badbit | std::ios::failbit);
+                os.open(tmp, std::ios::binary);
+            } catch (const std::ios::failure& e) {
+                throw std::runtime_error("failed to open binary file: " + tmp);
+            }
+            os.exceptions(old_state);
+            {
+                cereal::BinaryOutputArchive archive(os);
+                archive(obj);
+            }
+            os.close();
+            if (!os) {
+                std::remove(tmp.c_str());
+                throw std::runtime_error("failed to write binary file: " + tmp);
+            }
+        }
+        if (std::rename(tmp.c_str(), file.c_str())) {
+            std::remove(tmp.c_str());
+            throw std::runtime_error("failed to rename binary file: " + file);
         }
-        os.exceptions(old_state);
-        cereal::BinaryOutputArchive archive(os);
-        archive(obj);
     }
 
     template <typename T>
@@ -0,0 +1,81 @@
+#include "tokenizer.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+MappedFile::MappedFile(const std::string& file, bool sequential) {
+    int fd = open(file.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd == -1 || fstat(fd, &st) == -1) {
+        if (fd != -1) {
+            close(fd);
+        }
+        throw std::runtime_error("failed to open file: " + file);
+    }
+
+    length = st.st_size;
+    if (length) {
+        mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        mapping = nullptr;
+        throw std::runtime_error("failed to map file: " + file);
+    }
+    if (mapping && sequential) {
+        madvise(mapping, length, MADV_SEQUENTIAL);
+    }
+}
+
+MappedFile::MappedFile(MappedFile&& other)
+    : mapping(other.mapping), length(other.length) {
+    other.mapping = nullptr;
+    other.length = 0;
+}
+
+MappedFile::~MappedFile() {
+    if (mapping) {
+        munmap(mapping, length);
+    }
+}
+
+const char* MappedFile::begin() const {
+    return static_cast<const char*>(mapping);
+}
+
+const char* MappedFile::end() const {
+    return begin() + length;
+}
+
+std::size_t MappedFile::size() const {
+    return length;
+}
+
+const char* MappedFile::line(const char* p) const {
+    if (p <= begin() || p >= end() || p[-1] == '\n') {
+        return std::min(std::max(p, begin()), end());
+    }
+    const char* q =
+        static_cast<const char*>(std::memchr(p, '\n', end() - p));
+    return q ? q + 1 : end();
+}
+
+std::vector<Shard> shards(
+    const std::vector<MappedFile>& corpora, unsigned long num) {
+    std::vector<Shard> result;
+    for (const auto& corpus : corpora) {
+        std::size_t step = corpus.size() / num + 1;
+        const char* begin = corpus.begin();
+        while (begin != corpus.end()) {
+            const char* end = corpus.line(
+                begin + std::min(step, std::size_t(corpus.end() - begin)));
+            result.push_back({begin, end});
+            begin = end;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,105 @@
+#ifndef _SRC_TOKENIZER_H_
+#define _SRC_TOKENIZER_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Read-only memory mapped file, read ahead aggressively if `sequential`
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& file, bool sequential = true);
+    MappedFile(const MappedFile& other) = delete;
+    MappedFile(MappedFile&& other);
+    ~MappedFile();
+
+    const char* begin() const;
+    const char* end() const;
+    std::size_t size() const;
+
+    // First line start at or after `p`
+    const char* line(const char* p) const;
+
+private:
+    void* mapping = nullptr;
+    std::size_t length = 0;
+};
+
+// Byte range of a corpus, aligned to line starts
+struct Shard {
+    const char* begin;
+    const char* end;
+};
+
+// Split mapped files into about `num` byte ranges each
+std::vector<Shard> shards(
+    const std::vector<MappedFile>& corpora, unsigned long num);
+
+// A token pointing into the tokenized buffer
+struct Token {
+    const char* data = nullptr;
+    std::size_t size = 0;
+};
+
+// Split a buffer into tokens separated by blanks, reporting line breaks. No
+// memory is allocated and tokens are only valid as long as the buffer.
+class Tokenizer {
+public:
+    enum Event { END, TOKEN, NEWLINE };
+
+    Tokenizer(const char* begin, const char* end) : p(begin), last(end) {}
+
+    Event next(Token& token) {
+        while (p != last && is_delimiter(*p) && *p != '\n') {
+            ++p;
+        }
+        if (p == last) {
+            return END;
+        }
+        if (*p == '\n') {
+            ++p;
+            return NEWLINE;
+        }
+
+        token.data = p;
+        p = find_delimiter(p, last);
+        token.size = p - token.data;
+        return TOKEN;
+    }
+
+    static bool is_delimiter(char c) {
+        return c == ' ' || (c >= '\t' && c <= '\r');
+    }
+
+    // Scan 16 bytes at a time for a blank or a line break
+    static const char* find_delimiter(const char* p, const char* end) {
+#ifdef __SSE2__
+        const __m128i space = _mm_set1_epi8(' ');
+        const __m128i low = _mm_set1_epi8('\t' - 1);
+        const __m128i high = _mm_set1_epi8('\r' + 1);
+        for (; p + 16 <= end; p += 16) {
+            __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            __m128i mask = _mm_or_si128(
+                _mm_cmpeq_epi8(c, space),
+                _mm_and_si128(_mm_cmpgt_epi8(c, low), _mm_cmplt_epi8(c, high)));
+            int bits = _mm_movemask_epi8(mask);
+            if (bits) {
+                return p + __builtin_ctz(bits);
+            }
+        }
+#endif
+        while (p != end && !is_delimiter(*p)) {
+            ++p;
+        }
+        return p;
+    }
+
+private:
+    const char* p;
+    const char* last;
+};
+
+#endif /* _SRC_TOKENIZER_H_ */
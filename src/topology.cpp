@@ -0,0 +1,96 @@
+#include "topology.h"
+#include <unistd.h>
+#include <cstdint>
+#ifdef GLOVE_NUMA
+#include <numa.h>
+#include <numaif.h>
+#endif
+
+#ifdef GLOVE_NUMA
+// Whole pages inside a range, mbind only takes page aligned addresses
+static bool pages(
+    const void* data, std::size_t bytes, void*& begin, unsigned long& length) {
+    std::uintptr_t page = sysconf(_SC_PAGESIZE);
+    std::uintptr_t first = reinterpret_cast<std::uintptr_t>(data);
+    std::uintptr_t last = (first + bytes) / page * page;
+    first = (first + page - 1) / page * page;
+    if (first >= last) {
+        return false;
+    }
+    begin = reinterpret_cast<void*>(first);
+    length = last - first;
+    return true;
+}
+#endif
+
+std::vector<int> NumaTopology::nodes() {
+    std::vector<int> result;
+#ifdef GLOVE_NUMA
+    if (numa_available() != -1) {
+        struct bitmask* cpus = numa_allocate_cpumask();
+        for (int node = 0; node <= numa_max_node(); ++node) {
+            if (!numa_bitmask_isbitset(numa_all_nodes_ptr, node) ||
+                numa_node_to_cpus(node, cpus) == -1) {
+                continue;
+            }
+            for (unsigned int cpu = 0; cpu != cpus->size; ++cpu) {
+                if (numa_bitmask_isbitset(cpus, cpu) &&
+                    numa_bitmask_isbitset(numa_all_cpus_ptr, cpu)) {
+                    result.push_back(node);
+                    break;
+                }
+            }
+        }
+        numa_free_cpumask(cpus);
+    }
+#endif
+    if (result.empty()) {
+        result.push_back(0);
+    }
+    return result;
+}
+
+void NumaTopology::run_on(int node) {
+#ifdef GLOVE_NUMA
+    if (numa_available() != -1) {
+        numa_run_on_node(node);
+    }
+#else
+    static_cast<void>(node);
+#endif
+}
+
+void NumaTopology::bind(const void* data, std::size_t bytes, int node) {
+#ifdef GLOVE_NUMA
+    void* begin;
+    unsigned long length;
+    if (numa_available() == -1 || !pages(data, bytes, begin, length)) {
+        return;
+    }
+    struct bitmask* mask = numa_allocate_nodemask();
+    numa_bitmask_setbit(mask, node);
+    mbind(
+        begin, length, MPOL_BIND, mask->maskp, mask->size + 1, MPOL_MF_MOVE);
+    numa_free_nodemask(mask);
+#else
+    static_cast<void>(data);
+    static_cast<void>(bytes);
+    static_cast<void>(node);
+#endif
+}
+
+void NumaTopology::interleave(const void* data, std::size_t bytes) {
+#ifdef GLOVE_NUMA
+    void* begin;
+    unsigned long length;
+    if (numa_available() == -1 || !pages(data, bytes, begin, length)) {
+        return;
+    }
+    mbind(
+        begin, length, MPOL_INTERLEAVE, numa_all_nodes_ptr->maskp,
+        numa_all_nodes_ptr->size + 1, MPOL_MF_MOVE);
+#else
+    static_cast<void>(data);
+    static_cast<void>(bytes);
+#endif
+}
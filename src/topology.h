@@ -0,0 +1,25 @@
+#ifndef _SRC_TOPOLOGY_H_
+#define _SRC_TOPOLOGY_H_
+
+#include <cstddef>
+#include <vector>
+
+// NUMA placement of threads and memory. Without libnuma, or when the kernel
+// lacks NUMA support, the machine is a single node and placement is a no-op.
+// Memory placement is best effort and failures are ignored.
+class NumaTopology {
+public:
+    NumaTopology() = delete;
+
+    // Nodes with CPUs the process may run on, at least one
+    static std::vector<int> nodes();
+
+    // Pin the calling thread to the CPUs of a node
+    static void run_on(int node);
+
+    // Move the pages in a range to a node, or spread them over all nodes
+    static void bind(const void* data, std::size_t bytes, int node);
+    static void interleave(const void* data, std::size_t bytes);
+};
+
+#endif /* _SRC_TOPOLOGY_H_ */
@@ -1,8 +1,10 @@
 #include "util.h"
+#include <sys/stat.h>
 #include <algorithm>
 #include <iostream>
 #include <ostream>
 #include <sstream>
+#include <stdexcept>
 #include <vector>
 
 std::string lower(const std::string &str) {
@@ -29,3 +31,99 @@ std::string trim_left(const std::string &s, const char &delimiter) {
 std::string trim_right(const std::string &s, const char &delimiter) {
     return trim(s, delimiter, false, true);
 }
+
+namespace file {
+
+std::uint64_t fingerprint(
+    const std::vector<std::string> &files, std::uint64_t seed) {
+    // FNV-1a
+    std::uint64_t hash = seed;
+    auto update = [&hash](const void *data, std::size_t size) {
+        const unsigned char *bytes = static_cast<const unsigned char *>(data);
+        for (std::size_t i = 0; i != size; ++i) {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+    };
+
+    for (const auto &file : files) {
+        struct stat st;
+        if (stat(file.c_str(), &st) == -1) {
+            throw std::runtime_error("failed to stat file: " + file);
+        }
+        std::int64_t meta[] = {std::int64_t(st.st_size),
+                               std::int64_t(st.st_mtime)};
+        update(file.c_str(), file.size() + 1);
+        update(meta, sizeof(meta));
+    }
+
+    return hash;
+}
+
+}  // namespace file
+
+WorkerPool::WorkerPool(std::size_t num) : errors(num) {
+    for (std::size_t i = 0; i != num; ++i) {
+        workers.emplace_back(&WorkerPool::work, this, i);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    started.notify_all();
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+void WorkerPool::run(const std::function<void(std::size_t)> &func) {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        task = &func;
+        pending = workers.size();
+        ++round;
+        started.notify_all();
+        finished.wait(lock, [this]() { return !pending; });
+        task = nullptr;
+    }
+    for (auto &error : errors) {
+        if (error) {
+            std::exception_ptr first = error;
+            std::fill(errors.begin(), errors.end(), nullptr);
+            std::rethrow_exception(first);
+        }
+    }
+}
+
+std::size_t WorkerPool::size() const {
+    return workers.size();
+}
+
+void WorkerPool::work(std::size_t i) {
+    std::uint64_t seen = 0;
+    for (;;) {
+        const std::function<void(std::size_t)> *func;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            started.wait(lock, [&]() { return stopping || round != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = round;
+            func = task;
+        }
+
+        try {
+            (*func)(i);
+        } catch (...) {
+            errors[i] = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!--pending) {
+            finished.notify_one();
+        }
+    }
+}
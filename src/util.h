@@ -3,11 +3,19 @@
 
 #include <algorithm>
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
 #include <fstream>
+#include <functional>
 #include <initializer_list>
 #include <iostream>
 #include <iterator>
+#include <mutex>
+#include <new>
 #include <sstream>
+#include <thread>
 #include <vector>
 
 std::string lower(const std::string &str);
@@ -75,11 +83,14 @@ std::string join(Arg &&arg, Args &&... args) {
 namespace file {
 
 template <class Stream>
-Stream &open(Stream &stream, const std::string &file) {
+Stream &open(
+    Stream &stream,
+    const std::string &file,
+    std::ios_base::openmode mode = std::ios_base::openmode()) {
     auto old_state = stream.exceptions();
     try {
         stream.exceptions(stream.badbit | stream.failbit);
-        stream.open(file);
+        stream.open(file, mode);
     } catch (const std::ios_base::failure &e) {
         throw std::runtime_error("failed to open file: " + file);
     }
@@ -88,8 +99,97 @@ Stream &open(Stream &stream, const std::string &file) {
     return stream;
 }
 
+// Cheap identity of a set of files from their paths, sizes and modification
+// times, the contents are never read. A previous fingerprint can be chained
+// in through `seed`.
+std::uint64_t fingerprint(
+    const std::vector<std::string> &files,
+    std::uint64_t seed = 14695981039346656037ull);
+
 }  // namespace file
 
+// Run `func(i)` for i in [0, num) on as many threads and rethrow the first
+// exception after all of them are joined
+template <typename F>
+void parallel(std::size_t num, F func) {
+    std::vector<std::exception_ptr> errors(num);
+    std::vector<std::thread> workers;
+    for (std::size_t i = 0; i != num; ++i) {
+        workers.emplace_back([&func, &errors, i]() {
+            try {
+                func(i);
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        });
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    for (const auto &error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+// Threads kept alive across rounds of work. A round runs `func(i)` on every
+// worker i and returns once all of them are done, rethrowing the first
+// exception.
+class WorkerPool {
+public:
+    explicit WorkerPool(std::size_t num);
+    WorkerPool(const WorkerPool &other) = delete;
+    ~WorkerPool();
+
+    void run(const std::function<void(std::size_t)> &func);
+    std::size_t size() const;
+
+private:
+    void work(std::size_t i);
+
+    std::vector<std::thread> workers;
+    std::vector<std::exception_ptr> errors;
+    std::mutex mutex;
+    std::condition_variable started;
+    std::condition_variable finished;
+    const std::function<void(std::size_t)> *task = nullptr;
+    std::uint64_t round = 0;
+    std::size_t pending = 0;
+    bool stopping = false;
+};
+
+// Allocator honouring the alignment of over-aligned types, which the default
+// one does not guarantee before C++17
+template <typename T>
+struct AlignedAllocator {
+    using value_type = T;
+
+    AlignedAllocator() = default;
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U> &) {}
+
+    T *allocate(std::size_t n) {
+        void *ptr = nullptr;
+        std::size_t alignment = std::max(alignof(T), sizeof(void *));
+        if (posix_memalign(&ptr, alignment, n * sizeof(T))) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T *>(ptr);
+    }
+    void deallocate(T *ptr, std::size_t) { std::free(ptr); }
+};
+
+template <typename T, typename U>
+bool operator==(const AlignedAllocator<T> &, const AlignedAllocator<U> &) {
+    return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const AlignedAllocator<T> &, const AlignedAllocator<U> &) {
+    return false;
+}
+
 class Timer {
 public:
     Timer() = default;
@@ -1,20 +1,286 @@
 #include "vocabulary.h"
 #include <algorithm>
+#include <atomic>
 #include <cereal/types/map.hpp>
 #include <cereal/types/string.hpp>
 #include <cereal/types/unordered_map.hpp>
+#include <cereal/types/vector.hpp>
 #include <chrono>
+#include <cstdio>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <memory>
 #include <random>
 #include <sstream>
+#include <stdexcept>
 #include <unordered_map>
+#include "encoder.h"
+#include "gzip.h"
+#include "tokenizer.h"
 #include "util.h"
 
 bool operator<(const WordFreq &w1, const WordFreq &w2) {
     return w1.second < w2.second || w1.first < w2.first;
 }
 
+// WordTable
+WordTable::WordTable() : offsets(1, 0), slots(16, 0) {
+    sync();
+}
+
+WordTable::WordTable(const WordTable &other)
+    : view(other.view),
+      mapping(other.mapping),
+      chars(other.chars),
+      offsets(other.offsets),
+      counts(other.counts),
+      hashes(other.hashes),
+      slots(other.slots) {
+    if (!mapping) {
+        sync();
+    }
+}
+
+WordTable::WordTable(WordTable &&other)
+    : view(other.view),
+      mapping(std::move(other.mapping)),
+      chars(std::move(other.chars)),
+      offsets(std::move(other.offsets)),
+      counts(std::move(other.counts)),
+      hashes(std::move(other.hashes)),
+      slots(std::move(other.slots)) {
+    if (!mapping) {
+        sync();
+    }
+    other.clear();
+}
+
+std::uint32_t WordTable::hash(const char *data, std::size_t size, bool fold) {
+    // FNV-1a, folding ASCII upper case letters on the fly
+    std::uint32_t h = 2166136261u;
+    for (std::size_t i = 0; i != size; ++i) {
+        unsigned char c = data[i];
+        if (fold && c >= 'A' && c <= 'Z') {
+            c += 'a' - 'A';
+        }
+        h = (h ^ c) * 16777619u;
+    }
+    return h;
+}
+
+std::size_t WordTable::add(const std::string &word, CountType count) {
+    own();
+    std::size_t id;
+    if (find(word.data(), word.size(), false, id)) {
+        counts[id] += count;
+        return id;
+    }
+
+    id = size();
+    chars.insert(chars.end(), word.begin(), word.end());
+    offsets.push_back(chars.size());
+    counts.push_back(count);
+    hashes.push_back(hash(word.data(), word.size(), false));
+    if (2 * hashes.size() > slots.size()) {
+        rehash(2 * slots.size());
+    } else {
+        std::size_t mask = slots.size() - 1;
+        std::size_t h = hashes[id] & mask;
+        while (slots[h]) {
+            h = (h + 1) & mask;
+        }
+        slots[h] = id + 1;
+    }
+    sync();
+    return id;
+}
+
+bool WordTable::find(
+    const char *data, std::size_t size, bool fold, std::size_t &id) const {
+    std::uint32_t h = hash(data, size, fold);
+    std::size_t mask = view.capacity - 1;
+    for (std::size_t k = h & mask; view.slots[k]; k = (k + 1) & mask) {
+        std::size_t i = view.slots[k] - 1;
+        if (view.hashes[i] != h ||
+            view.offsets[i + 1] - view.offsets[i] != size) {
+            continue;
+        }
+
+        // Stored words are already lower case when folding
+        const char *word = view.chars + view.offsets[i];
+        std::size_t n = 0;
+        for (; n != size; ++n) {
+            char c = data[n];
+            if (fold && c >= 'A' && c <= 'Z') {
+                c += 'a' - 'A';
+            }
+            if (c != word[n]) {
+                break;
+            }
+        }
+        if (n == size) {
+            id = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string WordTable::operator[](std::size_t id) const {
+    if (id >= size()) {
+        throw std::out_of_range("word id out of range");
+    }
+    return std::string(
+        view.chars + view.offsets[id],
+        view.offsets[id + 1] - view.offsets[id]);
+}
+
+CountType WordTable::count(std::size_t id) const {
+    if (id >= size()) {
+        throw std::out_of_range("word id out of range");
+    }
+    return view.counts[id];
+}
+
+std::size_t WordTable::size() const {
+    return view.size;
+}
+
+void WordTable::clear() {
+    mapping.reset();
+    chars.clear();
+    offsets.assign(1, 0);
+    counts.clear();
+    hashes.clear();
+    slots.assign(16, 0);
+    sync();
+}
+
+void WordTable::rehash(std::size_t capacity) {
+    slots.assign(capacity, 0);
+    std::size_t mask = capacity - 1;
+    for (std::size_t i = 0; i != hashes.size(); ++i) {
+        std::size_t h = hashes[i] & mask;
+        while (slots[h]) {
+            h = (h + 1) & mask;
+        }
+        slots[h] = i + 1;
+    }
+}
+
+void WordTable::own() {
+    if (!mapping) {
+        return;
+    }
+    chars.assign(view.chars, view.chars + view.offsets[view.size]);
+    offsets.assign(view.offsets, view.offsets + view.size + 1);
+    counts.assign(view.counts, view.counts + view.size);
+    hashes.assign(view.hashes, view.hashes + view.size);
+    slots.assign(view.slots, view.slots + view.capacity);
+    mapping.reset();
+    sync();
+}
+
+void WordTable::sync() {
+    view.chars = chars.data();
+    view.offsets = offsets.data();
+    view.counts = counts.data();
+    view.hashes = hashes.data();
+    view.slots = slots.data();
+    view.size = hashes.size();
+    view.capacity = slots.size();
+}
+
+// Size of an array rounded up to 8 bytes
+template <typename T>
+static std::size_t padded(std::size_t n) {
+    return (n * sizeof(T) + 7) / 8 * 8;
+}
+
+template <typename T>
+static void write_array(std::ostream &os, const T *data, std::size_t n) {
+    static const char zeros[8] = {0};
+    os.write(reinterpret_cast<const char *>(data), n * sizeof(T));
+    os.write(zeros, padded<T>(n) - n * sizeof(T));
+}
+
+void WordTable::write(std::ostream &os) const {
+    std::uint64_t sizes[] = {view.size, view.offsets[view.size],
+                             view.capacity};
+    os.write(reinterpret_cast<const char *>(sizes), sizeof(sizes));
+    write_array(os, view.offsets, view.size + 1);
+    write_array(os, view.counts, view.size);
+    write_array(os, view.hashes, view.size);
+    write_array(os, view.slots, view.capacity);
+    write_array(os, view.chars, view.offsets[view.size]);
+}
+
+const char *WordTable::map(std::shared_ptr<MappedFile> file, const char *data) {
+    std::uint64_t sizes[3];
+    if (std::size_t(file->end() - data) < sizeof(sizes)) {
+        throw std::runtime_error("truncated vocabulary table");
+    }
+    std::copy(data, data + sizeof(sizes), reinterpret_cast<char *>(sizes));
+    std::size_t size = sizes[0], length = sizes[1], capacity = sizes[2];
+    if (!capacity || (capacity & (capacity - 1)) || 2 * size > capacity) {
+        throw std::runtime_error("invalid vocabulary table");
+    }
+
+    const char *p = data + sizeof(sizes);
+    std::size_t total = padded<std::uint64_t>(size + 1) +
+                        padded<CountType>(size) +
+                        padded<std::uint32_t>(size) +
+                        padded<std::uint32_t>(capacity) + padded<char>(length);
+    if (std::size_t(file->end() - p) < total) {
+        throw std::runtime_error("truncated vocabulary table");
+    }
+
+    View mapped;
+    mapped.offsets = reinterpret_cast<const std::uint64_t *>(p);
+    p += padded<std::uint64_t>(size + 1);
+    mapped.counts = reinterpret_cast<const CountType *>(p);
+    p += padded<CountType>(size);
+    mapped.hashes = reinterpret_cast<const std::uint32_t *>(p);
+    p += padded<std::uint32_t>(size);
+    mapped.slots = reinterpret_cast<const std::uint32_t *>(p);
+    p += padded<std::uint32_t>(capacity);
+    mapped.chars = p;
+    p += padded<char>(length);
+    mapped.size = size;
+    mapped.capacity = capacity;
+
+    clear();
+    view = mapped;
+    mapping = std::move(file);
+    return p;
+}
+
+void WordTable::serialize(cereal::BinaryOutputArchive &archive) {
+    own();
+    archive(chars, offsets, counts);
+}
+
+void WordTable::serialize(cereal::BinaryInputArchive &archive) {
+    clear();
+    archive(chars, offsets, counts);
+    if (offsets.empty()) {
+        offsets.assign(1, 0);
+    }
+    counts.resize(offsets.size() - 1);
+    hashes.clear();
+    for (std::size_t i = 0; i + 1 < offsets.size(); ++i) {
+        hashes.push_back(hash(
+            chars.data() + offsets[i], offsets[i + 1] - offsets[i], false));
+    }
+    std::size_t capacity = 16;
+    while (capacity < 2 * hashes.size()) {
+        capacity *= 2;
+    }
+    rehash(capacity);
+    sync();
+}
+
 // Vocabulary
 Vocabulary::Vocabulary(unsigned long mc, CountType ms, bool kc)
     : min_count(mc), max_size(ms), keep_case(kc) {}
@@ -23,17 +289,13 @@ Vocabulary::Vocabulary(const Vocabulary &other)
     : min_count(other.min_count),
       max_size(other.max_size),
       keep_case(other.keep_case),
-      freq(other.freq),
-      itoa(other.itoa),
-      atoi(other.atoi) {}
+      table(other.table) {}
 
 Vocabulary::Vocabulary(Vocabulary &&other)
     : min_count(other.min_count),
       max_size(other.max_size),
       keep_case(other.keep_case),
-      freq(std::move(other.freq)),
-      itoa(std::move(other.itoa)),
-      atoi(std::move(other.atoi)) {}
+      table(std::move(other.table)) {}
 
 void Vocabulary::build(const std::vector<WordFreq> &v) {
     clear();
@@ -42,66 +304,232 @@ void Vocabulary::build(const std::vector<WordFreq> &v) {
     }
 }
 
-void Vocabulary::build(const std::string &file) {
-    std::ifstream ifs;
-    file::open(ifs, file);
-
-    std::string line;
-    std::unordered_map<std::string, unsigned int> counts;
-    std::string key;
-
-    // Statistics
-    while (getline(ifs, line)) {
-        std::vector<std::string> &&_words = split(line);
+void Vocabulary::build(
+    const std::string &file, unsigned long threads, bool bounded) {
+    return build(std::vector<std::string>{file}, threads, bounded);
+}
 
-        for (const auto &word : _words) {
-            key = keep_case ? word : lower(word);
-            ++counts[key];
+// Tokenize the corpora on `threads` threads, calling `func(t, token)` for
+// every token seen by thread t
+template <typename F>
+static void tokenize(
+    const std::vector<std::string> &files, unsigned long threads, F func) {
+    std::vector<MappedFile> corpora;
+    std::vector<std::unique_ptr<GzipReader>> readers;
+    for (const auto &file : files) {
+        if (IdCorpus::detect(file)) {
+            throw std::runtime_error(
+                "cannot build vocabulary from encoded corpus: " + file);
+        } else if (GzipReader::detect(file)) {
+            readers.emplace_back(new GzipReader(file));
+        } else {
+            corpora.emplace_back(file);
         }
     }
-    ifs.close();
+    std::vector<Shard> jobs = shards(corpora, threads);
+
+    std::atomic<std::size_t> cursor(0);
+    parallel(threads, [&](std::size_t t) {
+        auto scan = [&](const char *begin, const char *end) {
+            Tokenizer tokenizer(begin, end);
+            Token token;
+            Tokenizer::Event event;
+            while ((event = tokenizer.next(token)) != Tokenizer::END) {
+                if (event == Tokenizer::TOKEN) {
+                    func(t, token);
+                }
+            }
+        };
+        for (std::size_t k = cursor++; k < jobs.size(); k = cursor++) {
+            scan(jobs[k].begin, jobs[k].end);
+        }
+        std::vector<char> block;
+        for (auto &reader : readers) {
+            while (reader->next(block)) {
+                scan(block.data(), block.data() + block.size());
+            }
+        }
+    });
+}
 
-    // Remove low frequencies
+void Vocabulary::build(
+    const std::vector<std::string> &files,
+    unsigned long threads,
+    bool bounded) {
+    using Counts = std::unordered_map<std::string, CountType>;
+    threads = std::max(threads, 1ul);
+
+    // Number of candidates kept in bounded mode, split into the counters of
+    // the threads so that all of them together stay proportional to it
+    std::size_t capacity = std::max(max_size, CountType(1)) * 4;
+    std::size_t share = std::max(capacity / threads, std::size_t(1) << 6);
+    std::vector<std::size_t> entries(threads, 0);
+
+    // Map: every thread counts into its own tables, partitioned by hash so
+    // that the partitions can be reduced independently
+    std::vector<std::vector<Counts>> partials(
+        threads, std::vector<Counts>(threads));
+    std::vector<std::string> keys(threads);
+    tokenize(files, threads, [&](std::size_t t, const Token &token) {
+        // The key buffer is reused so that only new words allocate
+        std::string &key = keys[t];
+        key.assign(token.data, token.size);
+        if (!keep_case) {
+            std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+        }
+        std::vector<Counts> &counts = partials[t];
+        auto it = counts[std::hash<std::string>()(key) % threads].emplace(
+            key, 0);
+        ++it.first->second;
+        entries[t] += it.second;
+
+        // Misra-Gries summary: once there are twice as many counters as
+        // allowed, subtract the count of the median one from all of them
+        if (bounded && entries[t] >= 2 * share) {
+            entries[t] = prune(counts, share);
+        }
+    });
+
+    // Reduce: every thread sums up one partition and removes low frequencies
+    std::vector<std::vector<WordFreq>> reduced(threads);
+    parallel(threads, [&](std::size_t p) {
+        Counts &total = partials[0][p];
+        for (std::size_t t = 1; t != threads; ++t) {
+            for (const auto &w : partials[t][p]) {
+                total[w.first] += w.second;
+            }
+            Counts().swap(partials[t][p]);
+        }
+        for (const auto &w : total) {
+            if (w.second >= min_count || bounded) {
+                reduced[p].push_back(w);
+            }
+        }
+        Counts().swap(total);
+    });
     std::vector<WordFreq> vec;
-    std::copy_if(
-        counts.begin(), counts.end(), std::back_inserter(vec),
-        [&](const WordFreq &w) { return w.second >= this->min_count; });
+    for (auto &part : reduced) {
+        vec.insert(
+            vec.end(), std::make_move_iterator(part.begin()),
+            std::make_move_iterator(part.end()));
+    }
+
+    // The summary only nominates candidates, which are counted again exactly
+    if (bounded) {
+        if (vec.size() > capacity) {
+            std::nth_element(
+                vec.begin(), vec.begin() + capacity, vec.end(),
+                [](const WordFreq &w1, const WordFreq &w2) {
+                    return w1.second > w2.second;
+                });
+            vec.erase(vec.begin() + capacity, vec.end());
+        }
+        WordTable candidates;
+        for (const auto &w : vec) {
+            candidates.add(w.first);
+        }
+        std::vector<std::vector<CountType>> exact(
+            threads, std::vector<CountType>(candidates.size(), 0));
+        tokenize(files, threads, [&](std::size_t t, const Token &token) {
+            std::size_t id;
+            if (candidates.find(token.data, token.size, !keep_case, id)) {
+                ++exact[t][id];
+            }
+        });
 
-    // Trim to max size
+        vec.clear();
+        for (std::size_t id = 0; id != candidates.size(); ++id) {
+            CountType count = 0;
+            for (const auto &counts : exact) {
+                count += counts[id];
+            }
+            if (count >= min_count) {
+                vec.emplace_back(candidates[id], count);
+            }
+        }
+    }
+
+    // Trim to max size, ties are broken by word to keep the result
+    // independent of the number of threads
     std::sort(
         vec.begin(), vec.end(), [](const WordFreq &w1, const WordFreq &w2) {
-            return w1.second > w2.second;
+            return w1.second > w2.second ||
+                   (w1.second == w2.second && w1.first < w2.first);
         });
-    vec.erase(min(vec.begin() + max_size, vec.end()), vec.end());
+    if (vec.size() > max_size) {
+        vec.erase(vec.begin() + max_size, vec.end());
+    }
 
     return build(vec);
 }
 
+std::size_t Vocabulary::prune(
+    std::vector<std::unordered_map<std::string, CountType>> &counts,
+    std::size_t capacity) {
+    std::vector<CountType> values;
+    for (const auto &part : counts) {
+        for (const auto &w : part) {
+            values.push_back(w.second);
+        }
+    }
+    if (values.size() <= capacity) {
+        return values.size();
+    }
+    std::nth_element(
+        values.begin(), values.begin() + capacity, values.end(),
+        std::greater<CountType>());
+    CountType cut = values[capacity];
+
+    std::size_t left = 0;
+    for (auto &part : counts) {
+        for (auto it = part.begin(); it != part.end();) {
+            if (it->second <= cut) {
+                it = part.erase(it);
+            } else {
+                it->second -= cut;
+                ++it;
+                ++left;
+            }
+        }
+    }
+    return left;
+}
+
 void Vocabulary::add(const std::string &word, CountType freq) {
     std::string key = keep_case ? word : lower(word);
-    if (has(key, true)) {
-        this->freq[key] += freq;
-    } else if (!full()) {
-        std::size_t id = size();
-        this->freq[key] += freq;
-        this->atoi[key] = id;
-        this->itoa[id] = key;
+    if (has(key, true) || !full()) {
+        table.add(key, freq);
     }
     return;
 }
 
+bool Vocabulary::find(
+    const char *data, std::size_t size, std::size_t &id) const {
+    return table.find(data, size, !keep_case, id);
+}
+
+bool Vocabulary::find(const std::string &word, std::size_t &id) const {
+    return find(word.data(), word.size(), id);
+}
+
 bool Vocabulary::has(const std::string &word) const {
-    return freq.count(keep_case ? word : lower(word)) > 0;
+    std::size_t id;
+    return find(word, id);
 }
 
 bool Vocabulary::has(const std::string &word, bool ignore_case) const {
     // If `ignore_case` is `true`, find directly, else respect the private
     // member `keep_case`
-    return ignore_case ? freq.count(word) > 0 : has(word);
+    std::size_t id;
+    return ignore_case ? table.find(word.data(), word.size(), false, id)
+                       : has(word);
 }
 
 void Vocabulary::merge(const Vocabulary &other) {
-    return merge(other.freq);
+    for (std::size_t i = 0; i != other.size(); ++i) {
+        add(other.table[i], other.table.count(i));
+    }
+    return;
 }
 
 void Vocabulary::merge(const WordMap &freq) {
@@ -112,9 +540,10 @@ void Vocabulary::merge(const WordMap &freq) {
 }
 
 void Vocabulary::sort(const std::string &order) {
-    std::vector<WordFreq> vec(
-        std::make_move_iterator(freq.begin()),
-        std::make_move_iterator(freq.end()));
+    std::vector<WordFreq> vec;
+    for (std::size_t i = 0; i != size(); ++i) {
+        vec.emplace_back(table[i], table.count(i));
+    }
 
     if (order == "desc" || order == "asc") {
         auto compare = [&order](const WordFreq &w1, const WordFreq &w2) {
@@ -122,7 +551,7 @@ void Vocabulary::sort(const std::string &order) {
                                    : w1.second < w2.second;
             // TODO: by freq and alphabet
         };
-        std::sort(vec.begin(), vec.end(), compare);
+        std::stable_sort(vec.begin(), vec.end(), compare);
 
     } else if (order == "rand") {
         unsigned seed =
@@ -135,88 +564,125 @@ void Vocabulary::sort(const std::string &order) {
 
 std::set<std::string> Vocabulary::words() const {
     std::set<std::string> keys;
-    for (const auto &word : freq) {
-        keys.insert(word.first);
+    for (std::size_t i = 0; i != size(); ++i) {
+        keys.insert(table[i]);
     }
     return keys;
 }
 
 std::size_t Vocabulary::size() const {
-    return freq.size();
+    return table.size();
 }
 
 bool Vocabulary::full() const {
-    return freq.size() >= max_size;
+    return size() >= max_size;
 }
 
 void Vocabulary::clear() {
-    freq.clear();
-    itoa.clear();
-    atoi.clear();
+    table.clear();
 }
 
 void Vocabulary::to_txt(const std::string &file) const {
     std::ofstream os(file);
     file::open(os, file);
-    for (const auto &it : freq) {
-        os << it.first << " " << it.second << std::endl;
+    for (std::size_t i = 0; i != size(); ++i) {
+        os << table[i] << " " << table.count(i) << std::endl;
     }
     os.close();
 
     std::ofstream os1, os2;
     file::open(os1, file + ".itoa");
     file::open(os2, file + ".atoi");
-    for (const auto &it : itoa) {
-        os1 << it.first << " " << it.second << std::endl;
-        os2 << it.second << " " << it.first << std::endl;
+    for (std::size_t i = 0; i != table.size(); ++i) {
+        os1 << i << " " << table[i] << std::endl;
+        os2 << table[i] << " " << i << std::endl;
     }
     os1.close();
     os2.close();
 }
 
-void Vocabulary::serialize(cereal::BinaryOutputArchive &archive) {
-    archive(min_count, max_size, keep_case, freq, itoa, atoi);
-}
-
-void Vocabulary::serialize(cereal::BinaryInputArchive &archive) {
-    archive(min_count, max_size, keep_case, freq, itoa, atoi);
+// Vocabulary file header, followed by the word table
+struct VocabHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t keep_case;
+    std::uint64_t min_count;
+    std::uint64_t max_size;
+};
+
+static const char vocab_magic[8] = {'G', 'L', 'O', 'V', 'E', 'V', 'O', '\0'};
+static const std::uint32_t vocab_version = 1;
+
+void Vocabulary::save(const std::string &file) const {
+    VocabHeader header;
+    std::copy(vocab_magic, vocab_magic + 8, header.magic);
+    header.version = vocab_version;
+    header.keep_case = keep_case;
+    header.min_count = min_count;
+    header.max_size = max_size;
+
+    // Write next to the target and move it into place once complete
+    std::string tmp = file + ".tmp";
+    std::ofstream os;
+    file::open(os, tmp, std::ios::binary);
+    os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    table.write(os);
+    os.close();
+    if (!os || std::rename(tmp.c_str(), file.c_str())) {
+        throw std::runtime_error("failed to write vocabulary file: " + file);
+    }
 }
 
-WordMap::iterator Vocabulary::begin() {
-    return freq.begin();
-}
+void Vocabulary::load(const std::string &file) {
+    std::shared_ptr<MappedFile> mapping(new MappedFile(file, false));
+    VocabHeader header;
+    if (mapping->size() < sizeof(header)) {
+        throw std::runtime_error("invalid vocabulary file: " + file);
+    }
+    std::copy(
+        mapping->begin(), mapping->begin() + sizeof(header),
+        reinterpret_cast<char *>(&header));
+    if (!std::equal(vocab_magic, vocab_magic + 8, header.magic) ||
+        header.version != vocab_version) {
+        throw std::runtime_error("invalid vocabulary file: " + file);
+    }
 
-WordMap::iterator Vocabulary::end() {
-    return freq.end();
+    const char *data = mapping->begin() + sizeof(header);
+    table.map(mapping, data);
+    keep_case = header.keep_case;
+    min_count = header.min_count;
+    max_size = header.max_size;
 }
 
-WordMap::const_iterator Vocabulary::cbegin() {
-    return freq.cbegin();
+void Vocabulary::serialize(cereal::BinaryOutputArchive &archive) {
+    archive(min_count, max_size, keep_case);
+    table.serialize(archive);
 }
 
-WordMap::const_iterator Vocabulary::cend() {
-    return freq.cend();
+void Vocabulary::serialize(cereal::BinaryInputArchive &archive) {
+    archive(min_count, max_size, keep_case);
+    table.serialize(archive);
 }
 
 std::string Vocabulary::operator[](const std::size_t &i) const {
-    return itoa.at(i);
+    return table[i];
 }
 std::size_t Vocabulary::operator[](const std::string &w) const {
-    return atoi.at(w);
+    std::size_t id;
+    if (!find(w, id)) {
+        throw std::out_of_range("word not in vocabulary: " + w);
+    }
+    return id;
 }
 
 std::ostream &operator<<(std::ostream &os, const Vocabulary &vocab) {
     os << "freq:" << std::endl;
-    for (const auto &it : vocab.freq) {
-        os << it.first << " " << it.second << std::endl;
+    for (std::size_t i = 0; i != vocab.size(); ++i) {
+        os << vocab.table[i] << " " << vocab.table.count(i) << std::endl;
     }
     os << "itoa:" << std::endl;
-    for (const auto &it : vocab.itoa) {
-        os << it.first << " " << it.second << std::endl;
-    }
-    os << "atoi:" << std::endl;
-    for (const auto &it : vocab.atoi) {
-        os << it.first << " " << it.second << std::endl;
+    for (std::size_t i = 0; i != vocab.table.size(); ++i) {
+        os << i << " " << vocab.table[i] << std::endl;
     }
 
     return os;
@@ -2,21 +2,76 @@
 #define _SRC_VOCABULARY_H_
 
 #include <cereal/archives/binary.hpp>
+#include <cstdint>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <set>
 #include <unordered_map>
 #include <vector>
 #include "serialization.h"
+#include "tokenizer.h"
 
 using CountType = unsigned long long;
 using WordFreq = std::pair<std::string, CountType>;
 using WordMap = std::unordered_map<std::string, CountType>;
-using Itoa = std::unordered_map<std::size_t, std::string>;
-using Atoi = std::unordered_map<std::string, std::size_t>;
 
 bool operator<(const WordFreq &w1, const WordFreq &w2);
 
+// Words stored back to back in an arena and indexed by their dense ids along
+// with their counts, plus an open addressing table from words to ids.
+// Lookups never allocate and can fold ASCII case while hashing. The arrays
+// are either owned or point into a memory mapped vocabulary file.
+class WordTable {
+public:
+    WordTable();
+    WordTable(const WordTable &other);
+    WordTable(WordTable &&other);
+
+    // Id of `word`, which is appended if new, after adding `count` to it
+    std::size_t add(const std::string &word, CountType count = 0);
+    bool find(
+        const char *data, std::size_t size, bool fold, std::size_t &id) const;
+
+    std::string operator[](std::size_t id) const;
+    CountType count(std::size_t id) const;
+    std::size_t size() const;
+    void clear();
+
+    // Write the arrays in the layout `map` uses in place, 8 byte aligned
+    void write(std::ostream &os) const;
+    // Point into a mapped file at `data`, returns the end of the table
+    const char *map(std::shared_ptr<MappedFile> file, const char *data);
+
+    void serialize(cereal::BinaryOutputArchive &archive);
+    void serialize(cereal::BinaryInputArchive &archive);
+
+private:
+    static std::uint32_t hash(const char *data, std::size_t size, bool fold);
+    void rehash(std::size_t capacity);
+    void own();
+    void sync();
+
+    // Arrays used by the lookups
+    struct View {
+        const char *chars;
+        const std::uint64_t *offsets;
+        const CountType *counts;
+        const std::uint32_t *hashes;
+        const std::uint32_t *slots;
+        std::size_t size;
+        std::size_t capacity;
+    } view;
+
+    std::shared_ptr<MappedFile> mapping;
+    std::vector<char> chars;
+    std::vector<std::uint64_t> offsets;
+    std::vector<CountType> counts;
+    std::vector<std::uint32_t> hashes;
+    // Ids plus one, zero marks an empty slot
+    std::vector<std::uint32_t> slots;
+};
+
 class Vocabulary {
 public:
     explicit Vocabulary(
@@ -25,7 +80,18 @@ public:
     Vocabulary(Vocabulary &&other);
 
     void build(const std::vector<WordFreq> &v);
-    void build(const std::string &file);
+    // Count the words of corpora on `threads` threads. A `bounded` count
+    // keeps memory proportional to the max size: a Misra-Gries summary
+    // nominates the frequent words, which are then counted exactly in a
+    // second pass.
+    void build(
+        const std::string &file,
+        unsigned long threads = 1,
+        bool bounded = false);
+    void build(
+        const std::vector<std::string> &files,
+        unsigned long threads = 1,
+        bool bounded = false);
 
     void add(const std::string &word, CountType freq = 1);
     void remove(const std::string &word);
@@ -34,6 +100,11 @@ public:
     void sort(const std::string &order = "desc");
     std::set<std::string> words() const;
 
+    // Id of a word, folding case unless `keep_case`, without throwing for
+    // OOV words
+    bool find(const char *data, std::size_t size, std::size_t &id) const;
+    bool find(const std::string &word, std::size_t &id) const;
+
     bool has(const std::string &word) const;
     bool has(const std::string &word, bool ignore_case) const;
     std::size_t size() const;
@@ -42,26 +113,30 @@ public:
 
     void to_txt(const std::string &file) const;
 
+    // Compact binary vocabulary file, which is memory mapped when loaded so
+    // that it can be queried right away
+    void save(const std::string &file) const;
+    void load(const std::string &file);
+
     void serialize(cereal::BinaryOutputArchive &archive);
     void serialize(cereal::BinaryInputArchive &archive);
 
-    WordMap::iterator begin();
-    WordMap::iterator end();
-    WordMap::const_iterator cbegin();
-    WordMap::const_iterator cend();
-
     std::string operator[](const std::size_t &i) const;
     std::size_t operator[](const std::string &w) const;
 
     friend std::ostream &operator<<(std::ostream &os, const Vocabulary &vocab);
 
 private:
+    // Cut a Misra-Gries summary down to `capacity` counters, returning the
+    // number left
+    static std::size_t prune(
+        std::vector<std::unordered_map<std::string, CountType>> &counts,
+        std::size_t capacity);
+
     unsigned int min_count = 1;
     CountType max_size = 1e7;
     bool keep_case = false;
-    WordMap freq;
-    Itoa itoa;
-    Atoi atoi;
+    WordTable table;
 };
 
 #endif /* _SRC_VOCABULARY_H_ */
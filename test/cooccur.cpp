@@ -0,0 +1,422 @@
+#include "cooccur.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "chunk.h"
+
+using CoMap = std::map<std::pair<std::uint32_t, std::uint32_t>, double>;
+
+// Skewed random corpus, so that there are both frequent and rare pairs
+static void write_corpus(const std::string& file, unsigned seed, int lines) {
+    std::mt19937 rng(seed);
+    std::ofstream os(file);
+    for (int i = 0; i != lines; ++i) {
+        for (int k = 0; k != 12; ++k) {
+            os << "w" << rng() % (1 + rng() % 200) << " ";
+        }
+        os << "\n";
+    }
+}
+
+static CoMap to_map(const CoRecs& co) {
+    CoMap map;
+    for (const auto& record : co) {
+        auto key = std::make_pair(record.i, record.j);
+        EXPECT_TRUE(map.emplace(key, record.weight).second);
+    }
+    return map;
+}
+
+static void expect_near(const CoMap& expected, const CoMap& actual) {
+    ASSERT_EQ(expected.size(), actual.size());
+    for (const auto& entry : expected) {
+        auto iter = actual.find(entry.first);
+        ASSERT_TRUE(iter != actual.end());
+        EXPECT_NEAR(entry.second, iter->second, 1e-5 * entry.second);
+    }
+}
+
+// Naive count, independent of the builder: in every line each word and any
+// of the `window` words before it add up the inverse of their distance. Out
+// of vocabulary words take up their position.
+static CoMap naive_count(
+    const std::vector<std::string>& input,
+    const Vocabulary& vocab,
+    unsigned long window,
+    bool symmetric) {
+    CoMap map;
+    for (const auto& file : input) {
+        std::ifstream is(file);
+        std::string line;
+        while (std::getline(is, line)) {
+            std::istringstream words(line);
+            std::vector<std::size_t> ids;
+            std::vector<bool> known;
+            std::string word;
+            while (words >> word) {
+                std::size_t id = 0;
+                known.push_back(vocab.find(word, id));
+                ids.push_back(id);
+            }
+            for (std::size_t c = 0; c != ids.size(); ++c) {
+                std::size_t reach = std::min(c, std::size_t(window));
+                for (std::size_t d = 1; d <= reach; ++d) {
+                    if (!known[c] || !known[c - d]) {
+                        continue;
+                    }
+                    std::uint32_t i = ids[c], j = ids[c - d];
+                    map[std::make_pair(i, j)] += 1.0 / d;
+                    if (symmetric) {
+                        map[std::make_pair(j, i)] += 1.0 / d;
+                    }
+                }
+            }
+        }
+    }
+    return map;
+}
+
+class CoMatrixBuilderTest : public testing::Test {
+protected:
+    void SetUp() override {
+        write_corpus("test_cooccur1.txt", 1, 300);
+        write_corpus("test_cooccur2.txt", 2, 200);
+        vocab.build(files, 1);
+        vocab.sort("desc");
+    }
+
+    void TearDown() override {
+        std::remove("test_cooccur1.txt");
+        std::remove("test_cooccur2.txt");
+    }
+
+    CoMap reference(
+        const std::vector<std::string>& input,
+        unsigned long window = 10,
+        bool symmetric = true) {
+        return naive_count(input, vocab, window, symmetric);
+    }
+
+    std::vector<std::string> files = {
+        "test_cooccur1.txt", "test_cooccur2.txt"};
+    Vocabulary vocab;
+};
+
+TEST_F(CoMatrixBuilderTest, Counts) {
+    for (bool symmetric : {true, false}) {
+        for (unsigned long window : {1, 3, 10}) {
+            CoRecs co = CoMatrixBuilder::build(
+                files, vocab, window, symmetric, 5000 * 5000, false);
+            EXPECT_TRUE(std::is_sorted(co.begin(), co.end()));
+            expect_near(reference(files, window, symmetric), to_map(co));
+        }
+    }
+
+    // Rare words are left out of a smaller vocabulary
+    Vocabulary frequent(1, 50);
+    frequent.build(files, 1);
+    frequent.sort("desc");
+    CoRecs co =
+        CoMatrixBuilder::build(files, frequent, 5, true, 5000 * 5000, false);
+    expect_near(naive_count(files, frequent, 5, true), to_map(co));
+}
+
+TEST_F(CoMatrixBuilderTest, Threads) {
+    CoMap expected = reference(files);
+    CoRecs co = CoMatrixBuilder::build(
+        files, vocab, 10, true, 5000 * 5000, false, 0, "./", 4);
+    EXPECT_TRUE(std::is_sorted(co.begin(), co.end()));
+    expect_near(expected, to_map(co));
+}
+
+TEST_F(CoMatrixBuilderTest, Budget) {
+    CoMap expected = reference(files);
+    for (unsigned long threads : {1, 3}) {
+        // A few KB force the counts to spill into many chunks
+        for (double memory : {0.005, 0.05, 16.0}) {
+            CoRecs co = CoMatrixBuilder::build(
+                files, vocab, 10, true, 5000 * 5000, false, memory, "./",
+                threads);
+            EXPECT_TRUE(std::is_sorted(co.begin(), co.end()));
+            expect_near(expected, to_map(co));
+
+            co = CoMatrixBuilder::build(
+                files, vocab, 10, true, 5000 * 5000, true, memory, "./",
+                threads, 7);
+            expect_near(expected, to_map(co));
+        }
+    }
+}
+
+TEST_F(CoMatrixBuilderTest, Symmetric) {
+    CoMap co = to_map(
+        CoMatrixBuilder::build(files, vocab, 10, true, 5000 * 5000, false));
+    for (const auto& entry : co) {
+        auto iter =
+            co.find(std::make_pair(entry.first.second, entry.first.first));
+        ASSERT_TRUE(iter != co.end());
+        EXPECT_NEAR(entry.second, iter->second, 1e-5 * entry.second);
+    }
+
+    // Only the left context is counted otherwise
+    CoMap left = to_map(
+        CoMatrixBuilder::build(files, vocab, 10, false, 5000 * 5000, false));
+    EXPECT_LT(left.size(), co.size());
+}
+
+TEST_F(CoMatrixBuilderTest, Update) {
+    CoMap expected = reference(files);
+    CoRecs base = CoMatrixBuilder::build(
+        files[0], vocab, 10, true, 5000 * 5000, false);
+    for (double memory : {0.0, 0.005}) {
+        CoRecs co, sorted;
+        CoMatrixBuilder::update(
+            [&co](const CoRec& record) { co.push_back(record); },
+            [&sorted](const CoRec& record) { sorted.push_back(record); },
+            base, {files[1]}, vocab, 10, true, 5000 * 5000, true, memory,
+            "./", 2, 3);
+        expect_near(expected, to_map(co));
+        EXPECT_TRUE(std::is_sorted(sorted.begin(), sorted.end()));
+        expect_near(expected, to_map(sorted));
+    }
+}
+
+TEST_F(CoMatrixBuilderTest, Windows) {
+    std::vector<unsigned long> windows = {10, 2, 5};
+    for (double memory : {0.0, 0.02}) {
+        std::vector<CoRecs> cos(windows.size());
+        std::vector<CoSink> sinks;
+        for (auto& co : cos) {
+            sinks.emplace_back(
+                [&co](const CoRec& record) { co.push_back(record); });
+        }
+        CoMatrixBuilder::build(
+            sinks, files, vocab, windows, true, 5000 * 5000, true, memory,
+            "./", 2, 5);
+        for (std::size_t k = 0; k != windows.size(); ++k) {
+            expect_near(reference(files, windows[k]), to_map(cos[k]));
+        }
+    }
+}
+
+TEST(CoHashTest, Compact) {
+    CoHash hash(64);
+    hash.add(3, 1, 1);
+    hash.add(0, 2, 2);
+    hash.add(3, 1, 0.5);
+    hash.add(0, 1, 1);
+    EXPECT_FALSE(hash.full());
+
+    ASSERT_EQ(std::size_t(3), hash.compact());
+    const CoRec* data = hash.data();
+    EXPECT_EQ(CoRec(0, 1, 0), data[0]);
+    EXPECT_EQ(CoRec(0, 2, 0), data[1]);
+    EXPECT_EQ(CoRec(3, 1, 0), data[2]);
+    EXPECT_FLOAT_EQ(1.5, data[2].weight);
+
+    hash.clear();
+    EXPECT_TRUE(hash.empty());
+    for (std::uint32_t k = 0; !hash.full(); ++k) {
+        hash.add(k, k, 1);
+    }
+    EXPECT_EQ(std::size_t(48), hash.compact());
+}
+
+TEST(CoChunkTest, WriteRead) {
+    std::vector<CoRec> records;
+    for (std::uint32_t k = 0; k != 1000; ++k) {
+        records.emplace_back(k, k + 1, k);
+    }
+    CoChunk chunk("./");
+    chunk.write(records);
+    EXPECT_EQ(records.size(), chunk.size());
+
+    // Any buffer size reads the records back in order
+    for (std::size_t buffer : {1, 7, 1000, 4096}) {
+        chunk.rewind(buffer);
+        CoRec record;
+        for (const auto& expected : records) {
+            ASSERT_TRUE(chunk.next(record));
+            EXPECT_EQ(expected, record);
+            EXPECT_EQ(expected.weight, record.weight);
+        }
+        EXPECT_FALSE(chunk.next(record));
+    }
+}
+
+// Sorted runs of random records with repeated pairs, and their sum
+static std::vector<std::vector<CoRec>> runs(
+    std::size_t num, std::size_t length, CoMap& sum) {
+    std::mt19937 rng(num);
+    std::vector<std::vector<CoRec>> result(num);
+    for (auto& run : result) {
+        for (std::size_t k = 0; k != length; ++k) {
+            CoRec record(rng() % 50, rng() % 50, 1 + rng() % 4);
+            run.push_back(record);
+            sum[std::make_pair(record.i, record.j)] += record.weight;
+        }
+        aggregate(run);
+    }
+    return result;
+}
+
+static CoMap merged(std::vector<CoSource>& sources) {
+    CoMap map;
+    CoRec prev;
+    bool first = true;
+    merge(sources, [&](const CoRec& record) {
+        EXPECT_TRUE(first || prev < record);
+        first = false;
+        prev = record;
+        map[std::make_pair(record.i, record.j)] += record.weight;
+    });
+    return map;
+}
+
+TEST(MergeTest, Sources) {
+    CoMap expected;
+    auto sorted = runs(5, 300, expected);
+    std::vector<CoSource> sources;
+    for (const auto& run : sorted) {
+        std::size_t pos = 0;
+        sources.emplace_back([&run, pos](CoRec& record) mutable {
+            if (pos == run.size()) {
+                return false;
+            }
+            record = run[pos++];
+            return true;
+        });
+    }
+    expect_near(expected, merged(sources));
+}
+
+TEST(MergeTest, ReadChunks) {
+    // More chunks than the fan-in of the small buffers are merged in passes
+    CoMap expected;
+    auto sorted = runs(100, 50, expected);
+    for (std::size_t length : {0, 100, 1 << 20}) {
+        std::vector<CoChunk> chunks;
+        for (const auto& run : sorted) {
+            chunks.emplace_back("./");
+            chunks.back().write(run);
+        }
+        std::vector<CoSource> sources = read_chunks(chunks, length, "./");
+        EXPECT_LE(sources.size(), std::size_t(64));
+        expect_near(expected, merged(sources));
+    }
+}
+
+TEST(MergeTest, Collapse) {
+    CoMap expected;
+    auto sorted = runs(100, 50, expected);
+    std::vector<CoChunk> chunks;
+    for (const auto& run : sorted) {
+        chunks.emplace_back("./");
+        chunks.back().write(run);
+        collapse(chunks, 0, "./");
+        EXPECT_FALSE(collapsible(chunks, 0));
+        for (std::size_t k = 1; k < chunks.size(); ++k) {
+            EXPECT_GE(chunks[k - 1].level(), chunks[k].level());
+        }
+    }
+    // One chunk per level at most
+    EXPECT_LE(chunks.size(), std::size_t(8));
+
+    std::vector<CoSource> sources = read_chunks(chunks, 0, "./");
+    expect_near(expected, merged(sources));
+}
+
+TEST(ExternalSortTest, Sort) {
+    std::mt19937 rng(11);
+    CoRecs records;
+    CoMap expected;
+    for (std::size_t k = 0; k != 5000; ++k) {
+        CoRec record(rng() % 100, rng() % 100, 1);
+        records.push_back(record);
+        expected[std::make_pair(record.i, record.j)] += 1;
+    }
+    for (std::size_t length : {0, 64, 5000}) {
+        CoMap actual;
+        CoRec prev;
+        bool first = true;
+        external_sort(
+            records,
+            [&](const CoRec& record) {
+                EXPECT_TRUE(first || prev < record);
+                first = false;
+                prev = record;
+                actual[std::make_pair(record.i, record.j)] += record.weight;
+            },
+            length, "./");
+        expect_near(expected, actual);
+    }
+}
+
+TEST(CoShufflerTest, Permutation) {
+    std::vector<CoRec> records;
+    for (std::uint32_t k = 0; k != 10000; ++k) {
+        records.emplace_back(k / 100, k % 100, k);
+    }
+    for (std::size_t length : {0, 333, 2000, 20000}) {
+        CoShuffler shuffler("./", length, 42);
+        for (const auto& record : records) {
+            shuffler.add(record);
+        }
+        std::vector<CoRec> shuffled;
+        shuffler.flush(
+            [&shuffled](const CoRec& record) { shuffled.push_back(record); });
+        ASSERT_EQ(records.size(), shuffled.size());
+        EXPECT_FALSE(std::is_sorted(shuffled.begin(), shuffled.end()));
+        std::sort(shuffled.begin(), shuffled.end());
+        for (std::size_t k = 0; k != records.size(); ++k) {
+            EXPECT_EQ(records[k], shuffled[k]);
+            EXPECT_EQ(records[k].weight, shuffled[k].weight);
+        }
+    }
+}
+
+TEST(CoMatrixFileTest, Header) {
+    CoRecs co;
+    co.push_back(CoRec(0, 1, 2));
+    co.push_back(CoRec(1, 0, 2));
+    CoMatrixKey key;
+    key.fingerprint = 42;
+    key.window = 10;
+    CoMatrixFile::save("test_cooccur.bin", key, 7, co);
+
+    EXPECT_TRUE(CoMatrixFile::match("test_cooccur.bin", key, 7));
+    EXPECT_FALSE(CoMatrixFile::match("test_cooccur.bin", key, 8));
+    CoMatrixKey other = key;
+    other.window = 5;
+    EXPECT_FALSE(CoMatrixFile::match("test_cooccur.bin", other, 7));
+    EXPECT_FALSE(CoMatrixFile::match("test_cooccur.none", key, 7));
+
+    CoMatrixHeader header = CoMatrixFile::header("test_cooccur.bin");
+    EXPECT_EQ(key, header.key);
+    EXPECT_EQ(std::uint64_t(7), header.vocab);
+    CoRecs loaded = CoMatrixFile::load("test_cooccur.bin");
+    ASSERT_EQ(std::size_t(2), loaded.size());
+    EXPECT_EQ(CoRec(1, 0, 0), loaded[1]);
+
+    // Files of another version are rejected
+    header.version = CoMatrixFile::version - 1;
+    {
+        std::fstream fs(
+            "test_cooccur.bin",
+            std::ios::in | std::ios::out | std::ios::binary);
+        fs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+    EXPECT_FALSE(CoMatrixFile::match("test_cooccur.bin", key, 7));
+    EXPECT_THROW(
+        CoMatrixFile::header("test_cooccur.bin"), std::runtime_error);
+    EXPECT_THROW(CoMatrixFile::load("test_cooccur.bin"), std::runtime_error);
+
+    std::remove("test_cooccur.bin");
+}
@@ -0,0 +1,37 @@
+#include "encoder.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "tokenizer.h"
+
+TEST(IdCorpusTest, Encode) {
+    std::ofstream("test_encoder.txt") << "a b c\n\nb x a";
+    Vocabulary vocab;
+    vocab.build(std::vector<WordFreq>{{"a", 2}, {"b", 2}, {"c", 1}});
+
+    IdCorpusKey key;
+    key.fingerprint = 42;
+    IdCorpus::encode("test_encoder.ids", {"test_encoder.txt"}, vocab, key);
+    EXPECT_TRUE(IdCorpus::detect("test_encoder.ids"));
+    EXPECT_FALSE(IdCorpus::detect("test_encoder.txt"));
+    EXPECT_TRUE(IdCorpus::match("test_encoder.ids", key));
+    key.min_count = 5;
+    EXPECT_FALSE(IdCorpus::match("test_encoder.ids", key));
+
+    IdCorpusHeader header = IdCorpus::header("test_encoder.ids");
+    EXPECT_EQ(IdCorpus::signature(vocab), header.vocab);
+
+    const std::uint32_t n = IdCorpus::newline, oov = IdCorpus::oov;
+    std::vector<std::uint32_t> expected = {0, 1, 2, n, n, 1, oov, 0, n};
+    ASSERT_EQ(expected.size(), header.count);
+    MappedFile ids("test_encoder.ids");
+    const std::uint32_t *begin =
+        reinterpret_cast<const std::uint32_t *>(ids.begin() + sizeof(header));
+    EXPECT_EQ(
+        expected, std::vector<std::uint32_t>(begin, begin + header.count));
+
+    std::remove("test_encoder.txt");
+    std::remove("test_encoder.ids");
+}
@@ -0,0 +1,218 @@
+#include "glove.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "serialization.h"
+
+static std::vector<CoRec> records(std::size_t words) {
+    std::vector<CoRec> result;
+    for (std::uint32_t i = 0; i != words; ++i) {
+        for (std::uint32_t j = 0; j < words; j += 3) {
+            result.emplace_back(i, j, 1 + (i * j) % 7);
+        }
+    }
+    return result;
+}
+
+static std::string contents(const std::string& file) {
+    std::ifstream is(file, std::ios::binary);
+    return std::string(
+        std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+}
+
+template <typename T>
+class CheckpointTest : public testing::Test {};
+
+using Precisions = testing::Types<float, double>;
+TYPED_TEST_CASE(CheckpointTest, Precisions);
+
+TYPED_TEST(CheckpointTest, RoundTrip) {
+    for (std::string name : {"adagrad", "adam", "sgd"}) {
+        OptimizerOptions options;
+        options.name = name;
+        BasicGloVe<TypeParam> glove(20, 8, 1e-1, 0.75, 10, options);
+        std::vector<CoRec> co = records(20);
+        std::size_t count = 0;
+        glove.train_chunk(co.data(), co.size(), 0, 1, 0.05, count);
+        EXPECT_EQ(co.size(), count);
+        BinaryArchiver::save("test_glove.bin", glove);
+
+        BasicGloVe<TypeParam> loaded;
+        BinaryArchiver::load("test_glove.bin", loaded);
+        EXPECT_EQ(name, loaded.optimizer_options().name);
+        BinaryArchiver::save("test_glove.copy", loaded);
+        EXPECT_EQ(contents("test_glove.bin"), contents("test_glove.copy"));
+
+        // Training resumes exactly where it stopped
+        EXPECT_EQ(
+            glove.train_chunk(co.data(), co.size(), 0, 1, 0.05, count),
+            loaded.train_chunk(co.data(), co.size(), 0, 1, 0.05, count));
+    }
+    std::remove("test_glove.bin");
+    std::remove("test_glove.copy");
+}
+
+TEST(GloVeTest, PrecisionMismatch) {
+    BinaryArchiver::save("test_glove.f32", GloVe32(20, 8));
+    BinaryArchiver::save("test_glove.f64", GloVe(20, 8));
+
+    GloVe glove;
+    EXPECT_THROW(
+        BinaryArchiver::load("test_glove.f32", glove), std::runtime_error);
+    GloVe32 glove32;
+    EXPECT_THROW(
+        BinaryArchiver::load("test_glove.f64", glove32), std::runtime_error);
+    EXPECT_NO_THROW(BinaryArchiver::load("test_glove.f32", glove32));
+
+    std::remove("test_glove.f32");
+    std::remove("test_glove.f64");
+}
+
+TEST(GloVeTest, SinglePrecisionGradientCheck) {
+    // Debug builds check the gradient of every record, at the precision of
+    // the parameters
+    GloVe32 glove(20, 50, 1e-1, 0.75, 10);
+    std::vector<CoRec> co = records(20);
+    std::size_t count = 0;
+    testing::internal::CaptureStderr();
+    for (int epoch = 0; epoch != 5; ++epoch) {
+        glove.train_chunk(co.data(), co.size(), 0, 1, 0.05, count);
+    }
+    EXPECT_EQ("", testing::internal::GetCapturedStderr());
+
+    // A wrong gradient is still caught
+    GloVe32::Row u(1, 8), v(1, 8);
+    u.fill(1);
+    v.fill(1);
+    double weight = std::pow(3.0 / 10, 0.75);
+    double sigma = 8 - std::log(3.0);
+    double loss = 0.5 * weight * sigma * sigma;
+    sigma *= weight;
+    EXPECT_TRUE(glove.check_gradient(
+        3, loss, u, v, 0, 0, float(sigma) * v, float(sigma) * u, sigma,
+        sigma));
+    EXPECT_FALSE(glove.check_gradient(
+        3, loss, u, v, 0, 0, float(sigma) * v, float(sigma) * u, sigma,
+        1.01 * sigma));
+}
+
+// Indices of [0, num) in the order the chunks of an epoch are trained
+static std::vector<std::size_t> walk(
+    std::size_t num, bool reshuffle, unsigned long epoch) {
+    std::seed_seq seq{42ul, epoch};
+    std::mt19937_64 rng(seq);
+    std::vector<std::size_t> indices;
+    for (const auto& visit : visit_chunks(0, num, 1000, reshuffle, rng)) {
+        EXPECT_LT(visit.start, visit.size);
+        std::size_t k = visit.start;
+        for (std::size_t m = 0; m != visit.size; ++m) {
+            indices.push_back(visit.begin + k);
+            k = (k + visit.step) % visit.size;
+        }
+    }
+    return indices;
+}
+
+TEST(VisitTest, EveryRecordOnce) {
+    for (std::size_t num : {1, 999, 1000, 4321}) {
+        std::vector<std::size_t> first = walk(num, true, 0);
+        for (unsigned long epoch = 0; epoch != 5; ++epoch) {
+            std::vector<std::size_t> indices = walk(num, true, epoch);
+            ASSERT_EQ(num, indices.size());
+            if (num > 1000 && epoch) {
+                EXPECT_NE(first, indices);
+            }
+            std::sort(indices.begin(), indices.end());
+            for (std::size_t k = 0; k != num; ++k) {
+                ASSERT_EQ(k, indices[k]);
+            }
+        }
+
+        // In order without reshuffling
+        std::vector<std::size_t> indices = walk(num, false, 3);
+        EXPECT_TRUE(std::is_sorted(indices.begin(), indices.end()));
+        EXPECT_EQ(num, indices.size());
+    }
+}
+
+TEST(VisitTest, HeldOut) {
+    EXPECT_EQ(std::uint64_t(0), holdout_cut(0));
+    std::vector<CoRec> co;
+    for (std::uint32_t i = 0; i != 100; ++i) {
+        for (std::uint32_t j = 0; j != 100; ++j) {
+            co.emplace_back(i, j, 1);
+        }
+    }
+    std::uint64_t cut = holdout_cut(0.1);
+
+    // The same records are held out in every epoch, in any visiting order
+    std::set<std::pair<std::uint32_t, std::uint32_t>> expected;
+    for (unsigned long epoch = 0; epoch != 4; ++epoch) {
+        for (bool reshuffle : {false, true}) {
+            std::set<std::pair<std::uint32_t, std::uint32_t>> heldout;
+            for (std::size_t k : walk(co.size(), reshuffle, epoch)) {
+                if (held_out(co[k], cut)) {
+                    heldout.emplace(co[k].i, co[k].j);
+                }
+            }
+            if (expected.empty()) {
+                expected = heldout;
+            }
+            EXPECT_EQ(expected, heldout);
+        }
+    }
+    EXPECT_NEAR(1000, expected.size(), 100);
+
+    for (const auto& record : co) {
+        EXPECT_TRUE(held_out(record, holdout_cut(1)));
+        EXPECT_FALSE(held_out(record, 0));
+    }
+}
+
+TEST(VisitTest, HeldOutTraining) {
+    std::vector<CoRec> records;
+    for (std::uint32_t i = 0; i != 50; ++i) {
+        for (std::uint32_t j = 0; j != 50; ++j) {
+            records.emplace_back(i, j, 1 + (i + j) % 5);
+        }
+    }
+    std::size_t expected = 0;
+    for (bool reshuffle : {false, true}) {
+        CoRecs co;
+        for (const auto& record : records) {
+            co.push_back(record);
+        }
+        GloVe glove(50, 4);
+        TrainOptions options;
+        options.epochs = 2;
+        options.lr = 0.05;
+        options.threads = 2;
+        options.reshuffle = reshuffle;
+        options.seed = 1;
+        options.holdout = 0.2;
+        options.chkpt_freq = 10;
+        glove.train(co, options);
+        std::remove("glove.50.4.0");
+
+        std::size_t count = 0;
+        glove.evaluate_chunk(co.data(), co.size(), count);
+        if (!expected) {
+            expected = count;
+        }
+        EXPECT_EQ(expected, count);
+
+        // Training only counts the records it does not hold out
+        std::size_t trained = 0;
+        glove.train_chunk(co.data(), co.size(), 0, 1, 0.05, trained);
+        EXPECT_EQ(co.size(), trained + count);
+    }
+    EXPECT_NEAR(500, expected, 100);
+}
@@ -0,0 +1,57 @@
+#include "gzip.h"
+#include <gtest/gtest.h>
+#include <zlib.h>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+static std::string compress(const std::string &text) {
+    std::string file = "test_gzip.txt.gz";
+    gzFile gz = gzopen(file.c_str(), "wb");
+    gzwrite(gz, text.data(), text.size());
+    gzclose(gz);
+    return file;
+}
+
+TEST(GzipReaderTest, Detect) {
+    std::string file = compress("abc\n");
+    EXPECT_TRUE(GzipReader::detect(file));
+    std::ofstream("test_gzip.txt") << "abc\n";
+    EXPECT_FALSE(GzipReader::detect("test_gzip.txt"));
+    std::remove(file.c_str());
+    std::remove("test_gzip.txt");
+}
+
+TEST(GzipReaderTest, WholeLines) {
+    std::string text;
+    for (int i = 0; i != 1000; ++i) {
+        text += "line " + std::to_string(i) + (i % 7 ? " word\n" : "\n");
+    }
+    text += "unterminated";
+    std::string file = compress(text);
+
+    // Blocks smaller than a line have to be joined
+    for (std::size_t size : {1, 5, 64, 1 << 16}) {
+        GzipReader reader(file, size, 2);
+        std::vector<char> block;
+        std::string result;
+        while (reader.next(block)) {
+            ASSERT_FALSE(block.empty());
+            std::string s(block.begin(), block.end());
+            EXPECT_TRUE(
+                s.back() == '\n' || result.size() + s.size() == text.size());
+            result += s;
+        }
+        EXPECT_EQ(text, result);
+    }
+    std::remove(file.c_str());
+}
+
+TEST(GzipReaderTest, EarlyExit) {
+    std::string file = compress(std::string(1 << 20, 'a') + "\n");
+    {
+        GzipReader reader(file, 1 << 10, 1);
+    }
+    std::remove(file.c_str());
+}
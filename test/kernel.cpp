@@ -0,0 +1,110 @@
+#include "kernel.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+template <typename T>
+static void check(const std::string& isa) {
+    TrainKernel<T> kernel;
+    try {
+        kernel = TrainKernel<T>::select(isa);
+    } catch (const std::runtime_error&) {
+        return;
+    }
+    EXPECT_EQ(isa, kernel.isa);
+
+    // Odd lengths exercise the remainder loops
+    for (std::size_t n : {1, 7, 50, 301}) {
+        std::vector<T> w1(n), g1(n), w2(n), g2(n);
+        for (std::size_t k = 0; k != n; ++k) {
+            w1[k] = T(0.01) * (k % 13) - T(0.05);
+            w2[k] = T(0.02) * (k % 7) - T(0.03);
+            g1[k] = T(0.1) * (k % 3);
+            g2[k] = T(0.2) * (k % 5);
+        }
+
+        T dot = 0;
+        for (std::size_t k = 0; k != n; ++k) {
+            dot += w1[k] * w2[k];
+        }
+        EXPECT_NEAR(dot, kernel.dot(w1.data(), w2.data(), n), 1e-5);
+
+        // AdaGrad
+        std::vector<T> u1 = w1, h1 = g1, u2 = w2, h2 = g2;
+        T sigma = 0.5, lr = 0.05, eps = 1e-8;
+        for (std::size_t k = 0; k != n; ++k) {
+            T d1 = sigma * w2[k], d2 = sigma * w1[k];
+            h1[k] += d1 * d1;
+            h2[k] += d2 * d2;
+            u1[k] -= lr * d1 / std::sqrt(h1[k] + eps);
+            u2[k] -= lr * d2 / std::sqrt(h2[k] + eps);
+        }
+        std::vector<T> x1 = w1, a1 = g1, x2 = w2, a2 = g2;
+        kernel.adagrad(
+            x1.data(), a1.data(), x2.data(), a2.data(), sigma, lr, eps, n);
+        for (std::size_t k = 0; k != n; ++k) {
+            EXPECT_NEAR(u1[k], x1[k], 1e-5);
+            EXPECT_NEAR(u2[k], x2[k], 1e-5);
+            EXPECT_NEAR(h1[k], a1[k], 1e-5);
+            EXPECT_NEAR(h2[k], a2[k], 1e-5);
+        }
+
+        // Adam, with `g` as the first and `h` as the second moments
+        T beta1 = 0.9, beta2 = 0.99, lr1 = 0.01, lr2 = 0.02;
+        std::vector<T> m1 = g1, v1 = g1, m2 = g2, v2 = g2;
+        u1 = w1;
+        u2 = w2;
+        for (std::size_t k = 0; k != n; ++k) {
+            T d1 = sigma * w2[k], d2 = sigma * w1[k];
+            m1[k] = beta1 * m1[k] + (1 - beta1) * d1;
+            m2[k] = beta1 * m2[k] + (1 - beta1) * d2;
+            v1[k] = beta2 * v1[k] + (1 - beta2) * d1 * d1;
+            v2[k] = beta2 * v2[k] + (1 - beta2) * d2 * d2;
+            u1[k] -= lr1 * m1[k] / (std::sqrt(v1[k]) + eps);
+            u2[k] -= lr2 * m2[k] / (std::sqrt(v2[k]) + eps);
+        }
+        x1 = w1;
+        x2 = w2;
+        std::vector<T> n1 = g1, s1 = g1, n2 = g2, s2 = g2;
+        kernel.adam(
+            x1.data(), n1.data(), s1.data(), x2.data(), n2.data(), s2.data(),
+            sigma, lr1, lr2, beta1, beta2, eps, n);
+        for (std::size_t k = 0; k != n; ++k) {
+            EXPECT_NEAR(u1[k], x1[k], 1e-5);
+            EXPECT_NEAR(u2[k], x2[k], 1e-5);
+            EXPECT_NEAR(m1[k], n1[k], 1e-5);
+            EXPECT_NEAR(v2[k], s2[k], 1e-5);
+        }
+
+        // SGD
+        x1 = w1;
+        x2 = w2;
+        kernel.sgd(x1.data(), x2.data(), sigma, lr, n);
+        for (std::size_t k = 0; k != n; ++k) {
+            EXPECT_NEAR(w1[k] - lr * sigma * w2[k], x1[k], 1e-6);
+            EXPECT_NEAR(w2[k] - lr * sigma * w1[k], x2[k], 1e-6);
+        }
+    }
+}
+
+TEST(TrainKernelTest, Generic) {
+    check<float>("generic");
+    check<double>("generic");
+}
+
+TEST(TrainKernelTest, AVX2) {
+    check<float>("avx2");
+    check<double>("avx2");
+}
+
+TEST(TrainKernelTest, AVX512) {
+    check<float>("avx512");
+    check<double>("avx512");
+}
+
+TEST(TrainKernelTest, Select) {
+    EXPECT_NO_THROW(TrainKernel<float>::select());
+    EXPECT_THROW(TrainKernel<float>::select("sse9"), std::runtime_error);
+}
@@ -0,0 +1,75 @@
+#include "optimizer.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <stdexcept>
+
+static OptimizerOptions options(const std::string& name) {
+    OptimizerOptions opts;
+    opts.name = name;
+    return opts;
+}
+
+TEST(OptimizerTest, Create) {
+    EXPECT_EQ(1, Optimizer<float>::create(options("adagrad"))->states());
+    EXPECT_EQ(2, Optimizer<float>::create(options("adam"))->states());
+    EXPECT_EQ(0, Optimizer<double>::create(options("sgd"))->states());
+    EXPECT_EQ(
+        "adam", Optimizer<double>::create(options("adam"))->options().name);
+    EXPECT_THROW(
+        Optimizer<float>::create(options("rmsprop")), std::invalid_argument);
+}
+
+TEST(OptimizerTest, AdaGrad) {
+    auto optimizer = Optimizer<double>::create(options("adagrad"));
+    WordParams<double> W1(2, 1, 1), W2(2, 1, 1);
+    W1.vector(0)[0] = 1;
+    W2.vector(1)[0] = 2;
+    optimizer->update(W1, 0, W2, 1, 0.5, 0.1);
+    // Gradients 1 and 0.5, AdaGrad steps by the learning rate at first
+    EXPECT_NEAR(0.9, W1.vector(0)[0], 1e-6);
+    EXPECT_NEAR(1.9, W2.vector(1)[0], 1e-6);
+    EXPECT_NEAR(1, W1.state(0, 0)[0], 1e-12);
+    EXPECT_NEAR(0.25, W2.state(1, 0)[0], 1e-12);
+    EXPECT_NEAR(-0.1, W1.bias(0), 1e-6);
+    EXPECT_NEAR(-0.1, W2.bias(1), 1e-6);
+}
+
+TEST(OptimizerTest, Adam) {
+    auto optimizer = Optimizer<double>::create(options("adam"));
+    WordParams<double> W1(1, 1, 2), W2(1, 1, 2);
+    W1.vector(0)[0] = 1;
+    W2.vector(0)[0] = 2;
+    optimizer->update(W1, 0, W2, 0, 0.5, 0.1);
+    // The first bias corrected step is the learning rate times the sign
+    EXPECT_NEAR(0.9, W1.vector(0)[0], 1e-6);
+    EXPECT_NEAR(1.9, W2.vector(0)[0], 1e-6);
+    EXPECT_NEAR(-0.1, W1.bias(0), 1e-6);
+    EXPECT_EQ(1, W1.steps(0));
+    EXPECT_EQ(1, W2.steps(0));
+}
+
+TEST(OptimizerTest, AdamSteps) {
+    // Single precision counts updates beyond 2^24 all the same
+    auto optimizer = Optimizer<float>::create(options("adam"));
+    WordParams<float> W1(1, 3, 2), W2(1, 3, 2);
+    W1.steps(0) = 1 << 24;
+    optimizer->update(W1, 0, W2, 0, 0.5, 0.1);
+    EXPECT_EQ((1u << 24) + 1, W1.steps(0));
+    EXPECT_EQ(1, W2.steps(0));
+
+    // The count sits apart from the bias states and survives copies
+    WordParams<float> copy(W1);
+    EXPECT_EQ((1u << 24) + 1, copy.steps(0));
+    EXPECT_NEAR(0.25 * 0.001, copy.bias_state(0, 1), 1e-9);
+}
+
+TEST(OptimizerTest, SGD) {
+    auto optimizer = Optimizer<float>::create(options("sgd"));
+    WordParams<float> W1(1, 2, 0), W2(1, 2, 0);
+    W1.vector(0)[1] = 1;
+    W2.vector(0)[1] = 2;
+    optimizer->update(W1, 0, W2, 0, 0.5, 0.1);
+    EXPECT_NEAR(0.9, W1.vector(0)[1], 1e-6);
+    EXPECT_NEAR(1.95, W2.vector(0)[1], 1e-6);
+    EXPECT_NEAR(-0.05, W1.bias(0), 1e-6);
+}
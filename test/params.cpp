@@ -0,0 +1,59 @@
+#include "params.h"
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <utility>
+#include "serialization.h"
+
+TEST(WordParamsTest, Layout) {
+    WordParams<float> params(3, 5, 2);
+    EXPECT_EQ(3, params.words());
+    for (std::size_t i = 0; i != params.words(); ++i) {
+        std::uintptr_t address =
+            reinterpret_cast<std::uintptr_t>(params.vector(i));
+        EXPECT_EQ(0, address % WordParams<float>::alignment);
+        EXPECT_EQ(params.vector(i) + 5, params.state(i, 0));
+        EXPECT_EQ(params.vector(i) + 10, params.state(i, 1));
+        EXPECT_EQ(params.vector(i) + 15, &params.bias(i));
+        EXPECT_EQ(params.vector(i) + 16, &params.bias_state(i, 0));
+        EXPECT_EQ(params.vector(i) + 17, &params.bias_state(i, 1));
+        EXPECT_EQ(
+            params.vector(i) + 18,
+            reinterpret_cast<float*>(&params.steps(i)));
+        EXPECT_EQ(0, params.bias(i));
+    }
+
+    params.vector(1)[2] = 3;
+    arma::Mat<float> vectors = params.vectors();
+    EXPECT_EQ(5, vectors.n_rows);
+    EXPECT_EQ(3, vectors.n_cols);
+    EXPECT_EQ(3, vectors(2, 1));
+}
+
+TEST(WordParamsTest, Serialize) {
+    WordParams<double> params(4, 3);
+    params.vector(3)[2] = 1.5;
+    params.state(2, 0)[1] = 2.5;
+    params.bias(1) = -1;
+    BinaryArchiver::save("test_params.bin", params);
+    EXPECT_FALSE(std::ifstream("test_params.bin.tmp").good());
+
+    WordParams<double> loaded;
+    BinaryArchiver::load("test_params.bin", loaded);
+    EXPECT_EQ(4, loaded.words());
+    EXPECT_EQ(1.5, loaded.vector(3)[2]);
+    EXPECT_EQ(1, loaded.num_states());
+    EXPECT_EQ(2.5, loaded.state(2, 0)[1]);
+    EXPECT_EQ(-1, loaded.bias(1));
+
+    WordParams<double> copied(loaded);
+    EXPECT_EQ(1.5, copied.vector(3)[2]);
+    EXPECT_NE(loaded.vector(3), copied.vector(3));
+
+    WordParams<double> moved(std::move(loaded));
+    EXPECT_EQ(4, moved.words());
+    EXPECT_EQ(0, loaded.words());
+
+    std::remove("test_params.bin");
+}
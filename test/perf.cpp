@@ -0,0 +1,19 @@
+#include "perf.h"
+#include <gtest/gtest.h>
+
+TEST(PerfCountersTest, Count) {
+    PerfCounters counters;
+    counters.start();
+    volatile double sum = 0;
+    for (int k = 0; k != 1000000; ++k) {
+        sum += k;
+    }
+    counters.stop();
+
+    // Counters may be unavailable, e.g. in containers or virtual machines
+    std::int64_t instructions = counters.read(PerfCounters::INSTRUCTIONS);
+    EXPECT_TRUE(instructions == -1 || instructions >= 1000000);
+    for (int event = 0; event != PerfCounters::EVENTS; ++event) {
+        EXPECT_GE(counters.read(PerfCounters::Event(event)), -1);
+    }
+}
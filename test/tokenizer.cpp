@@ -0,0 +1,59 @@
+#include "tokenizer.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+static std::vector<std::string> tokenize(const std::string &text) {
+    std::vector<std::string> tokens;
+    Tokenizer tokenizer(text.data(), text.data() + text.size());
+    Token token;
+    Tokenizer::Event event;
+    while ((event = tokenizer.next(token)) != Tokenizer::END) {
+        tokens.push_back(
+            event == Tokenizer::NEWLINE ? "\n"
+                                        : std::string(token.data, token.size));
+    }
+    return tokens;
+}
+
+TEST(TokenizerTest, Blanks) {
+    std::vector<std::string> expected = {"abc", "def", "ijk"};
+    EXPECT_EQ(expected, tokenize("abc def ijk"));
+    EXPECT_EQ(expected, tokenize("  abc\tdef \r ijk  "));
+}
+
+TEST(TokenizerTest, LineBreaks) {
+    std::vector<std::string> expected = {"abc", "\n", "\n", "def", "\n"};
+    EXPECT_EQ(expected, tokenize("abc \n\ndef\r\n"));
+}
+
+TEST(TokenizerTest, LongTokens) {
+    std::string word(37, 'x');
+    std::vector<std::string> expected = {word, word, "\n", "y"};
+    EXPECT_EQ(expected, tokenize(word + " " + word + "\ny"));
+}
+
+TEST(MappedFileTest, LineStarts) {
+    std::string file = "mapped_file.txt";
+    std::ofstream(file) << "ab\ncd\n\nef";
+    {
+        MappedFile corpus(file);
+        ASSERT_EQ(9u, corpus.size());
+        const char *begin = corpus.begin();
+        EXPECT_EQ(begin, corpus.line(begin));
+        EXPECT_EQ(begin + 3, corpus.line(begin + 1));
+        EXPECT_EQ(begin + 3, corpus.line(begin + 3));
+        EXPECT_EQ(begin + 6, corpus.line(begin + 4));
+        EXPECT_EQ(begin + 6, corpus.line(begin + 6));
+        EXPECT_EQ(corpus.end(), corpus.line(begin + 8));
+    }
+    std::remove(file.c_str());
+    EXPECT_THROW(MappedFile corpus(file), std::runtime_error);
+}
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,19 @@
+#include "topology.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+TEST(NumaTopologyTest, Nodes) {
+    std::vector<int> nodes = NumaTopology::nodes();
+    ASSERT_FALSE(nodes.empty());
+    EXPECT_GE(nodes.front(), 0);
+}
+
+TEST(NumaTopologyTest, Placement) {
+    std::vector<int> nodes = NumaTopology::nodes();
+    std::vector<char> buffer(1 << 20, 1);
+    NumaTopology::run_on(nodes.back());
+    NumaTopology::bind(buffer.data(), buffer.size(), nodes.front());
+    NumaTopology::interleave(buffer.data() + 3, buffer.size() - 7);
+    NumaTopology::bind(buffer.data(), 1, nodes.front());
+    EXPECT_EQ(std::vector<char>(1 << 20, 1), buffer);
+}
@@ -1,5 +1,11 @@
 #include "util.h"
 #include <gtest/gtest.h>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
 
 TEST(SplitTest, DefaultDelimiter) {
     std::vector<std::string> strs = split("abc def ijk");
@@ -63,6 +69,60 @@ TEST(PathJoinTest, ManyPaths) {
     EXPECT_EQ("//aa/bb/cc", path::join("//aa//", "//bb//", "//cc//"));
 }
 
+TEST(FingerprintTest, FileIdentity) {
+    std::string a = "fingerprint_a.txt", b = "fingerprint_b.txt";
+    std::ofstream(a) << "abc" << std::endl;
+    std::ofstream(b) << "abcdef" << std::endl;
+    EXPECT_EQ(file::fingerprint({a, b}), file::fingerprint({a, b}));
+    EXPECT_NE(file::fingerprint({a, b}), file::fingerprint({b, a}));
+    EXPECT_NE(file::fingerprint({a}), file::fingerprint({a, b}));
+
+    std::uint64_t before = file::fingerprint({a});
+    std::ofstream(a, std::ios::app) << "def" << std::endl;
+    EXPECT_NE(before, file::fingerprint({a}));
+
+    std::remove(a.c_str());
+    std::remove(b.c_str());
+    EXPECT_THROW(file::fingerprint({a}), std::runtime_error);
+}
+
+TEST(WorkerPoolTest, Rounds) {
+    WorkerPool pool(4);
+    EXPECT_EQ(4, pool.size());
+
+    std::vector<int> hits(4);
+    std::atomic<int> total(0);
+    for (int round = 0; round != 3; ++round) {
+        pool.run([&](std::size_t i) {
+            ++hits[i];
+            ++total;
+        });
+    }
+    EXPECT_EQ(std::vector<int>(4, 3), hits);
+    EXPECT_EQ(12, total);
+
+    EXPECT_THROW(
+        pool.run([](std::size_t i) {
+            if (i == 2) {
+                throw std::runtime_error("failed");
+            }
+        }),
+        std::runtime_error);
+    EXPECT_NO_THROW(pool.run([](std::size_t) {}));
+}
+
+TEST(AlignedAllocatorTest, CacheLines) {
+    struct alignas(64) Line {
+        char byte;
+    };
+    for (std::size_t n : {1, 3, 17}) {
+        std::vector<Line, AlignedAllocator<Line>> lines(n);
+        for (const auto &line : lines) {
+            EXPECT_EQ(0u, reinterpret_cast<std::uintptr_t>(&line) % 64);
+        }
+    }
+}
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
@@ -0,0 +1,162 @@
+#include "vocabulary.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+TEST(WordTableTest, AddFind) {
+    WordTable table;
+    for (int i = 0; i != 1000; ++i) {
+        EXPECT_EQ(std::size_t(i), table.add("w" + std::to_string(i)));
+    }
+    EXPECT_EQ(std::size_t(7), table.add("w7"));
+    EXPECT_EQ(std::size_t(1000), table.size());
+
+    std::size_t id;
+    for (int i = 0; i != 1000; ++i) {
+        std::string word = "w" + std::to_string(i);
+        ASSERT_TRUE(table.find(word.data(), word.size(), false, id));
+        EXPECT_EQ(std::size_t(i), id);
+        EXPECT_EQ(word, table[id]);
+    }
+    EXPECT_FALSE(table.find("w1000", 5, false, id));
+    EXPECT_FALSE(table.find("w", 1, false, id));
+    EXPECT_THROW(table[1000], std::out_of_range);
+}
+
+TEST(VocabularyTest, FoldCase) {
+    Vocabulary vocab;
+    vocab.build(std::vector<WordFreq>{{"Apple", 3}, {"pie", 2}});
+
+    std::size_t id;
+    ASSERT_TRUE(vocab.find("APPLE", id));
+    EXPECT_EQ(std::size_t(0), id);
+    ASSERT_TRUE(vocab.find("Pie", id));
+    EXPECT_EQ(std::size_t(1), id);
+    EXPECT_FALSE(vocab.find("tart", id));
+    EXPECT_EQ(std::size_t(1), vocab["pIE"]);
+    EXPECT_THROW(vocab["tart"], std::out_of_range);
+
+    Vocabulary cased(1, 10, true);
+    cased.build(std::vector<WordFreq>{{"Apple", 3}});
+    EXPECT_TRUE(cased.find("Apple", id));
+    EXPECT_FALSE(cased.find("apple", id));
+}
+
+TEST(VocabularyTest, Serialize) {
+    Vocabulary vocab;
+    vocab.build(std::vector<WordFreq>{{"a", 3}, {"b", 2}, {"c", 1}});
+
+    std::stringstream ss;
+    {
+        cereal::BinaryOutputArchive archive(ss);
+        vocab.serialize(archive);
+    }
+    Vocabulary loaded;
+    cereal::BinaryInputArchive archive(ss);
+    loaded.serialize(archive);
+
+    ASSERT_EQ(vocab.size(), loaded.size());
+    for (std::size_t i = 0; i != vocab.size(); ++i) {
+        EXPECT_EQ(vocab[i], loaded[i]);
+        EXPECT_EQ(i, loaded[vocab[i]]);
+    }
+}
+
+TEST(VocabularyTest, SaveLoad) {
+    Vocabulary vocab(2, 100, false);
+    for (int i = 0; i != 50; ++i) {
+        vocab.add("W" + std::to_string(i), i + 1);
+    }
+    vocab.save("test_vocabulary.bin");
+
+    Vocabulary loaded;
+    loaded.load("test_vocabulary.bin");
+    ASSERT_EQ(vocab.size(), loaded.size());
+    std::size_t id;
+    for (int i = 0; i != 50; ++i) {
+        ASSERT_TRUE(loaded.find("W" + std::to_string(i), id));
+        EXPECT_EQ(std::size_t(i), id);
+        EXPECT_EQ(vocab[i], loaded[i]);
+    }
+    EXPECT_FALSE(loaded.find("w50", id));
+
+    // Modifying a mapped vocabulary copies it first
+    Vocabulary copy(loaded);
+    loaded.add("w50");
+    loaded.add("w0", 2);
+    EXPECT_EQ(std::size_t(51), loaded.size());
+    EXPECT_EQ(std::size_t(50), loaded["w50"]);
+    EXPECT_EQ(std::size_t(50), copy.size());
+    EXPECT_FALSE(copy.find("w50", id));
+
+    EXPECT_THROW(loaded.load("test_vocabulary.txt"), std::runtime_error);
+    std::remove("test_vocabulary.bin");
+}
+
+TEST(VocabularyTest, BoundedBuild) {
+    // Zipfian counts, word k occurs about 2000 / (k + 1) times
+    {
+        std::ofstream os("test_vocabulary.txt");
+        std::mt19937 rng(1);
+        std::vector<std::string> tokens;
+        for (int k = 0; k != 2000; ++k) {
+            for (int n = 0; n != 2000 / (k + 1); ++n) {
+                tokens.push_back("w" + std::to_string(k));
+            }
+        }
+        std::shuffle(tokens.begin(), tokens.end(), rng);
+        for (std::size_t i = 0; i != tokens.size(); ++i) {
+            os << tokens[i] << (i % 10 == 9 ? "\n" : " ");
+        }
+    }
+
+    Vocabulary exact(1, 20);
+    exact.build("test_vocabulary.txt", 2);
+    for (unsigned long threads : {1, 2, 4}) {
+        Vocabulary bounded(1, 20);
+        bounded.build("test_vocabulary.txt", threads, true);
+        ASSERT_EQ(exact.size(), bounded.size());
+        for (std::size_t i = 0; i != exact.size(); ++i) {
+            EXPECT_EQ(exact[i], bounded[i]);
+        }
+    }
+    std::remove("test_vocabulary.txt");
+}
+
+TEST(VocabularyTest, BuildThreads) {
+    // Many words share a count, so that ties decide about ids and the cut
+    {
+        std::ofstream os("test_vocabulary.txt");
+        std::mt19937 rng(2);
+        std::vector<std::string> tokens;
+        for (int k = 0; k != 300; ++k) {
+            for (int n = 0; n != 1 + k % 5; ++n) {
+                tokens.push_back("w" + std::to_string(k));
+            }
+        }
+        std::shuffle(tokens.begin(), tokens.end(), rng);
+        for (std::size_t i = 0; i != tokens.size(); ++i) {
+            os << tokens[i] << (i % 7 == 6 ? "\n" : " ");
+        }
+    }
+
+    // Max sizes within a tie, and beyond the size of the vocabulary
+    for (CountType max_size : {100, 130, 1000}) {
+        Vocabulary single(2, max_size), parallel(2, max_size);
+        single.build(std::vector<std::string>{"test_vocabulary.txt"}, 1);
+        parallel.build(std::vector<std::string>{"test_vocabulary.txt"}, 4);
+        EXPECT_EQ(
+            std::min(max_size, CountType(240)), CountType(single.size()));
+
+        std::ostringstream expected, actual;
+        expected << single;
+        actual << parallel;
+        EXPECT_EQ(expected.str(), actual.str());
+    }
+    std::remove("test_vocabulary.txt");
+}
@@ -1,22 +1,75 @@
 #include <args.hxx>
 #include <armadillo>
+#include <dirent.h>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <memory>
+#include <stdexcept>
 #include <thread>
 #include <vector>
+#include "chunk.h"
 #include "cooccur.h"
+#include "encoder.h"
 #include "glove.h"
+#include "optimizer.h"
 #include "serialization.h"
 #include "util.h"
 #include "vocabulary.h"
 
+// Remove the matrices of other windows kept in `dir`, which are only valid
+// with the vocabulary they were built with
+static void remove_window_files(const std::string& dir) {
+    DIR* handle = opendir(dir.c_str());
+    if (!handle) {
+        return;
+    }
+    while (dirent* entry = readdir(handle)) {
+        std::string name = entry->d_name;
+        if (name.size() > 13 && name.compare(0, 9, "cooccur.w") == 0 &&
+            name.compare(name.size() - 4, 4, ".bin") == 0) {
+            std::remove(path::join(dir, name).c_str());
+        }
+    }
+    closedir(handle);
+}
+
+// Train a model with parameters of type `T`, resuming from `model` if given
+template <typename T>
+static void fit(
+    const CoRecs& co,
+    const Vocabulary& v,
+    const std::string& model,
+    unsigned long size,
+    double threshold,
+    const OptimizerOptions& optimizer,
+    TrainOptions options) {
+    BasicGloVe<T> glove(v.size(), size, 1e-3, 0.75, threshold, optimizer);
+    if (!model.empty()) {
+        BinaryArchiver::load(model, glove);
+        if (glove.optimizer_options().name != optimizer.name) {
+            throw std::runtime_error(
+                "model optimizer mismatch: expected " + optimizer.name +
+                ", got " + glove.optimizer_options().name);
+        }
+        options.init_epoch = std::stol(split(model, '.').at(3)) + 1;
+        std::cout << "Loaded previous trained model: " << model << std::endl;
+    }
+    glove.train(co, options);
+    glove.to_txt(path::join(options.logdir, "wordvec.txt"), v);
+}
+
 int main(int argc, char** argv) {
     args::ArgumentParser parser(
         "GloVe: Global Vectors for Word Representation");
     args::HelpFlag help(
         parser, "help", "Display this help menu", {'h', "help"});
     args::ValueFlag<std::string> input(
-        parser, "input", "Corpus file", {"input"}, args::Options::Required);
+        parser, "input",
+        "Corpus file(s), separated by commas, may be gzip compressed",
+        {"input"}, args::Options::Required);
     args::ValueFlag<std::string> model(
         parser, "model", "GloVe model", {"model"});
     args::ValueFlag<std::string> logdir(
@@ -30,12 +83,39 @@ int main(int argc, char** argv) {
     args::Flag keep_case(
         parser, "keep_case", "Whether to keep case when build vocabulary",
         {"keep-case"}, false);
+    args::Flag bounded_vocab(
+        parser, "bounded_vocab",
+        "Count the vocabulary in memory proportional to --vocab-size, "
+        "whatever the number of threads, approximately finding frequent "
+        "words and then recounting them",
+        {"bounded-vocab"});
     args::ValueFlag<unsigned long> window(
         parser, "window", "Window size for building cooccur matrix", {"window"},
         10);
     args::Flag symmetric(
         parser, "symmetric", "Whether to use symmetric window", {"symmetric"},
         true);
+    args::ValueFlag<double> memory(
+        parser, "memory_mb",
+        "Memory budget (MB) for building cooccur matrix, shared by all "
+        "threads, 0 for no limit",
+        {"memory-mb"}, 0);
+    args::ValueFlag<std::string> extra_windows(
+        parser, "extra_windows",
+        "Window sizes, separated by commas, whose co-occurrence matrices are "
+        "built in the same pass and kept for later runs with another --window",
+        {"extra-windows"});
+    args::Flag update(
+        parser, "update",
+        "Merge the counts of the input into the co-occurrence matrix of the "
+        "log directory, keeping its vocabulary",
+        {"update"});
+    args::Flag encode(
+        parser, "encode",
+        "Encode the corpus into vocabulary ids in the log directory once and "
+        "count co-occurrences from them, later runs with another window skip "
+        "tokenizing",
+        {"encode"});
     args::ValueFlag<unsigned long> size(
         parser, "size", "Word vector size", {"size"}, 200);
     args::ValueFlag<double> threshold(
@@ -45,14 +125,62 @@ int main(int argc, char** argv) {
         parser, "epochs", "Number of total epochs", {"epochs"}, 10);
     args::ValueFlag<double> lr(
         parser, "lr", "Learning rate", {"lr", "learning-rate"}, 1e-3);
+    args::ValueFlag<double> lr_decay(
+        parser, "lr_decay",
+        "Learning rate decay, the rate of epoch t is lr / (1 + decay * t)",
+        {"lr-decay"}, 0);
+    args::ValueFlag<std::string> optimizer(
+        parser, "optimizer",
+        "Optimizer, adagrad, adam (lazy, per word bias correction) or sgd",
+        {"optimizer"}, "adagrad");
+    args::ValueFlag<double> beta1(
+        parser, "beta1", "Adam decay of the first moment", {"beta1"}, 0.9);
+    args::ValueFlag<double> beta2(
+        parser, "beta2", "Adam decay of the second moment", {"beta2"}, 0.999);
+    args::ValueFlag<double> eps(
+        parser, "eps", "AdaGrad and Adam denominator epsilon", {"eps"}, 1e-8);
     args::ValueFlag<unsigned long> threads(
         parser, "threads", "Number of threads to use", {"threads"},
         std::thread::hardware_concurrency());
     args::ValueFlag<unsigned long> chkpt_freq(
         parser, "chkpt_freq", "Save checkpoint every given epochs",
         {"chkpt_freq"}, 5);
+    args::Flag numa(
+        parser, "numa",
+        "Pin training threads to NUMA nodes, interleave the parameters over "
+        "the nodes and keep a slice of the records in each node's memory",
+        {"numa"});
+    args::Flag reshuffle(
+        parser, "reshuffle",
+        "Visit the co-occurrence records in a new random order every epoch, "
+        "drawn in the background while the previous epoch trains",
+        {"reshuffle"});
+    args::ValueFlag<double> holdout(
+        parser, "holdout",
+        "Share of co-occurrence records held out of training, whose loss is "
+        "reported after every epoch",
+        {"holdout"}, 0);
+    args::ValueFlag<unsigned long> patience(
+        parser, "patience",
+        "Stop once the held-out loss improved by less than --tolerance for "
+        "this many epochs in a row, 0 to always run all epochs",
+        {"patience"}, 0);
+    args::ValueFlag<double> tolerance(
+        parser, "tolerance",
+        "Relative held-out loss improvement below which an epoch counts "
+        "towards --patience",
+        {"tolerance"}, 1e-3);
+    args::Flag perf(
+        parser, "perf",
+        "Append per epoch and thread throughput and hardware counters as JSON "
+        "lines to perf.jsonl in the log directory",
+        {"perf"});
     args::ValueFlag<unsigned long> seed(
         parser, "seed", "Random seed (should > 0)", {"seed"});
+    args::ValueFlag<std::string> precision(
+        parser, "precision",
+        "Parameter precision, f32 halves memory and checkpoint size",
+        {"precision"}, "f64");
 
     try {
         parser.ParseCLI(argc, argv);
@@ -68,46 +196,271 @@ int main(int argc, char** argv) {
         return 1;
     }
 
+    if (args::get(precision) != "f32" && args::get(precision) != "f64") {
+        std::cerr << "--precision should be f32 or f64" << std::endl;
+        return 1;
+    }
+
+    if (args::get(holdout) < 0 || args::get(holdout) >= 1) {
+        std::cerr << "--holdout should be in [0, 1)" << std::endl;
+        return 1;
+    }
+    if (args::get(patience) && !args::get(holdout)) {
+        std::cerr << "--patience requires --holdout" << std::endl;
+        return 1;
+    }
+
+    OptimizerOptions optimizer_options;
+    optimizer_options.name = args::get(optimizer);
+    optimizer_options.beta1 = args::get(beta1);
+    optimizer_options.beta2 = args::get(beta2);
+    optimizer_options.eps = args::get(eps);
+    const std::string& name = optimizer_options.name;
+    if (name != "adagrad" && name != "adam" && name != "sgd") {
+        std::cerr << "--optimizer should be adagrad, adam or sgd" << std::endl;
+        return 1;
+    }
+
     if (seed) {
         arma::arma_rng::set_seed(args::get(seed));
     } else {
         arma::arma_rng::set_seed_random();
     }
 
-    // Build vocabulary
-    std::cout << "Building vocabulary..." << std::endl;
+    // Reuse the vocabulary and co-occurrence matrix of a previous run if
+    // they were built from the same corpus with the same parameters
+    std::vector<std::string> inputs = split(args::get(input), ',');
+    std::string vocab_file = path::join(args::get(logdir), "vocab.bin");
+    std::string cooccur_file = path::join(args::get(logdir), "cooccur.bin");
+    CoMatrixKey key;
+    key.fingerprint = file::fingerprint(inputs);
+    key.window = args::get(window);
+    key.symmetric = args::get(symmetric);
+    key.min_count = args::get(min_count);
+    key.vocab_size = args::get(vocab_size);
+    key.keep_case = args::get(keep_case);
+
+    // A matrix is only valid together with the vocabulary it was counted
+    // against, which a later run may have rebuilt
+    std::uint64_t signature = 0;
+    bool vocab_found = std::ifstream(vocab_file).good();
+    if (vocab_found) {
+        Vocabulary saved;
+        saved.load(vocab_file);
+        signature = IdCorpus::signature(saved);
+    }
+
+    // Matrices of other windows are kept aside, swap in the requested one
+    auto window_file = [&logdir](std::uint64_t w) {
+        return path::join(
+            args::get(logdir), "cooccur.w" + std::to_string(w) + ".bin");
+    };
+    if (!CoMatrixFile::match(cooccur_file, key, signature) &&
+        CoMatrixFile::match(window_file(key.window), key, signature)) {
+        try {
+            CoMatrixHeader header = CoMatrixFile::header(cooccur_file);
+            if (header.vocab == signature) {
+                std::rename(
+                    cooccur_file.c_str(),
+                    window_file(header.key.window).c_str());
+            }
+        } catch (const std::runtime_error& e) {
+        }
+        std::rename(window_file(key.window).c_str(), cooccur_file.c_str());
+    }
+    bool cached =
+        vocab_found && CoMatrixFile::match(cooccur_file, key, signature);
+
     Vocabulary v = Vocabulary(
         args::get(min_count), args::get(vocab_size), args::get(keep_case));
-    v.build(args::get(input));
-    v.sort("desc");
-    BinaryArchiver::save(path::join(args::get(logdir), "vocab.bin"), v);
-    std::cout << "Vocab size: " << v.size() << std::endl;
-
-    // Build Co-occurrence matrix
-    std::cout << "Building co-occurrence matrix..." << std::endl;
+    CoRecs co;
     Timer timer;
-    timer.start();
-    CoRecs&& co = CoMatrixBuilder::build(
-        args::get(input), v, args::get(window), args::get(symmetric));
-    timer.stop();
-    std::cout << "Built co-occurrence matrix (took: " << std::setprecision(3)
-              << timer.elapsed() << "s)" << std::endl;
+    if (update) {
+        // Merge the counts of the new corpus into the previous matrix, the
+        // vocabulary stays fixed. Check that matrix before any work is done.
+        CoMatrixHeader header;
+        try {
+            if (!vocab_found) {
+                throw std::runtime_error(
+                    "failed to open vocabulary file: " + vocab_file);
+            }
+            header = CoMatrixFile::header(cooccur_file);
+        } catch (const std::runtime_error& e) {
+            std::cerr << "--update requires the vocabulary and co-occurrence "
+                         "matrix of a previous run: "
+                      << e.what() << std::endl;
+            return 1;
+        }
+        if (header.vocab != signature) {
+            std::cerr << "vocab.bin does not match the co-occurrence matrix "
+                         "to update"
+                      << std::endl;
+            return 1;
+        }
+        if (header.key.window != key.window ||
+            header.key.symmetric != key.symmetric ||
+            header.key.keep_case != key.keep_case) {
+            std::cerr << "--window, --symmetric and --keep-case should match "
+                         "the co-occurrence matrix to update"
+                      << std::endl;
+            return 1;
+        }
+
+        std::cout << "Updating co-occurrence matrix..." << std::endl;
+        timer.start();
+        v.load(vocab_file);
+        std::cout << "Vocab size: " << v.size() << std::endl;
+
+        // The update merges into a sorted copy of the matrix, which is made
+        // once and then kept up to date alongside the shuffled one
+        std::string sorted_file =
+            path::join(args::get(logdir), "cooccur.sorted.bin");
+        if (!CoMatrixFile::match(sorted_file, header.key, header.vocab)) {
+            CoRecs previous = CoMatrixFile::load(cooccur_file);
+            CoMatrixWriter writer(sorted_file, header.key, header.vocab, true);
+            external_sort(
+                previous,
+                [&writer](const CoRec& record) { writer.write(record); },
+                args::get(memory) * 1024 * 1024 / sizeof(CoRec),
+                args::get(logdir));
+            writer.close();
+        }
+
+        key = header.key;
+        key.fingerprint = file::fingerprint(inputs, header.key.fingerprint);
+
+        CoRecs base = CoMatrixFile::load(sorted_file);
+        CoMatrixWriter writer(cooccur_file, key, header.vocab);
+        CoMatrixWriter sorted_writer(sorted_file, key, header.vocab, true);
+        CoMatrixBuilder::update(
+            [&writer](const CoRec& record) { writer.write(record); },
+            [&sorted_writer](const CoRec& record) {
+                sorted_writer.write(record);
+            },
+            base, inputs, v, args::get(window), args::get(symmetric),
+            5000 * 5000, true, args::get(memory), args::get(logdir),
+            args::get(threads), seed ? args::get(seed) : 0);
+        writer.close();
+        sorted_writer.close();
+        co = CoMatrixFile::load(cooccur_file);
+        timer.stop();
+        std::cout << "Updated co-occurrence matrix (took: "
+                  << std::setprecision(3) << timer.elapsed() << "s)"
+                  << std::endl;
+    } else if (cached) {
+        std::cout << "Loading vocabulary and co-occurrence matrix..."
+                  << std::endl;
+        v.load(vocab_file);
+        co = CoMatrixFile::load(cooccur_file);
+        std::cout << "Vocab size: " << v.size() << std::endl;
+    } else {
+        // An encoded corpus of the same input comes with its vocabulary
+        std::string ids_file = path::join(args::get(logdir), "corpus.ids");
+        IdCorpusKey ids_key;
+        ids_key.fingerprint = key.fingerprint;
+        ids_key.min_count = key.min_count;
+        ids_key.vocab_size = key.vocab_size;
+        ids_key.keep_case = key.keep_case;
+        bool encoded = false;
+        if (encode && IdCorpus::match(ids_file, ids_key) &&
+            std::ifstream(vocab_file).good()) {
+            Vocabulary saved;
+            saved.load(vocab_file);
+            encoded = IdCorpus::header(ids_file).vocab ==
+                      IdCorpus::signature(saved);
+        }
+
+        // Build vocabulary
+        if (encoded) {
+            v.load(vocab_file);
+        } else {
+            std::cout << "Building vocabulary..." << std::endl;
+            v.build(inputs, args::get(threads), args::get(bounded_vocab));
+            v.sort("desc");
+            v.save(vocab_file);
+            remove_window_files(args::get(logdir));
+        }
+        std::cout << "Vocab size: " << v.size() << std::endl;
+
+        if (encode && !encoded) {
+            std::cout << "Encoding corpus..." << std::endl;
+            IdCorpus::encode(ids_file, inputs, v, ids_key);
+        }
+        if (encode) {
+            inputs = {ids_file};
+        }
+
+        // Build Co-occurrence matrix
+        std::cout << "Building co-occurrence matrix..." << std::endl;
+        timer.start();
+        std::vector<unsigned long> windows = {args::get(window)};
+        if (extra_windows) {
+            for (const auto& w : split(args::get(extra_windows), ',')) {
+                if (std::find(windows.begin(), windows.end(), std::stoul(w)) ==
+                    windows.end()) {
+                    windows.push_back(std::stoul(w));
+                }
+            }
+        }
+        std::vector<std::unique_ptr<CoMatrixWriter>> writers;
+        std::vector<CoSink> sinks;
+        for (auto w : windows) {
+            CoMatrixKey window_key = key;
+            window_key.window = w;
+            writers.emplace_back(new CoMatrixWriter(
+                w == key.window ? cooccur_file : window_file(w), window_key,
+                IdCorpus::signature(v)));
+            CoMatrixWriter* writer = writers.back().get();
+            sinks.emplace_back(
+                [writer](const CoRec& record) { writer->write(record); });
+        }
+        CoMatrixBuilder::build(
+            sinks, inputs, v, windows, args::get(symmetric), 5000 * 5000, true,
+            args::get(memory), args::get(logdir), args::get(threads),
+            seed ? args::get(seed) : 0);
+        for (auto& writer : writers) {
+            writer->close();
+        }
+        co = CoMatrixFile::load(cooccur_file);
+        timer.stop();
+        std::cout << "Built co-occurrence matrix (took: "
+                  << std::setprecision(3) << timer.elapsed() << "s)"
+                  << std::endl;
+    }
     std::cout << "Nonzero elements: " << co.size() << std::endl;
 
     // Train
     std::cout << "Training..." << std::endl;
-    unsigned long init_epoch = 0;
-    GloVe glove(v.size(), args::get(size), 1e-3, 0.75, args::get(threshold));
-    if (model) {
-        BinaryArchiver::load(args::get(model), glove);
-        init_epoch = std::stol(split(args::get(model), '.').at(3)) + 1;
-        std::cout << "Loaded previous trained model: " << args::get(model)
-                  << std::endl;
+    TrainOptions train_options;
+    train_options.epochs = args::get(epoch);
+    train_options.lr = args::get(lr);
+    train_options.lr_decay = args::get(lr_decay);
+    train_options.threads = args::get(threads);
+    train_options.numa = args::get(numa);
+    train_options.reshuffle = args::get(reshuffle);
+    train_options.seed = seed ? args::get(seed) : 0;
+    train_options.holdout = args::get(holdout);
+    train_options.patience = args::get(patience);
+    train_options.tolerance = args::get(tolerance);
+    train_options.perf = args::get(perf);
+    train_options.logdir = args::get(logdir);
+    train_options.chkpt_freq = args::get(chkpt_freq);
+
+    // A checkpoint to resume from may not fit the requested model
+    try {
+        if (args::get(precision) == "f32") {
+            fit<float>(
+                co, v, model ? args::get(model) : "", args::get(size),
+                args::get(threshold), optimizer_options, train_options);
+        } else {
+            fit<double>(
+                co, v, model ? args::get(model) : "", args::get(size),
+                args::get(threshold), optimizer_options, train_options);
+        }
+    } catch (const std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
     }
-    glove.train(
-        co, args::get(epoch), args::get(lr), args::get(threads),
-        args::get(logdir), init_epoch, args::get(chkpt_freq));
-    glove.to_txt(path::join(args::get(logdir), "wordvec.txt"), v);
 
     return 0;
 }